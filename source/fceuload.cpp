@@ -28,6 +28,7 @@
 #include "fileop.h"
 #include "filebrowser.h"
 #include "cheatmgr.h"
+#include "rewind.h"
 
 bool romLoaded = false;
 
@@ -129,6 +130,7 @@ int GCMemROM(int size)
 
 		FCEU_ResetPalette();
 		FCEU_ResetMessages();	// Save state, status messages, etc.
+		RewindReset();
 		SetupCheats();
 		ResetAudio();
 		return 1;
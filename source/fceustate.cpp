@@ -25,41 +25,71 @@
 #include "filebrowser.h"
 #include "fileop.h"
 #include "gcvideo.h"
+#include "pngwriter.h"
+#include "statewriter.h"
+#include "statestore.h"
 #include "utils/pngu.h"
+#include "fceux/video.h"
 
+// set by the state writer thread, read once the write is waited for
+static volatile bool stateWriteOk = false;
+
+static void StateWritten(const char *filepath, bool success)
+{
+	stateWriteOk = success;
+}
+
+/****************************************************************************
+ * SaveState
+ *
+ * The state is taken now, and compressed and written in the background.
+ * Unless silent, it waits for the write and prompts with the result.
+ ***************************************************************************/
 bool SaveState (char * filepath, bool silent)
 {
-	bool retval = false;
-	int datasize;
-	int offset = 0;
 	int device;
-			
+
 	if(!FindDevice(filepath, &device))
 		return 0;
 
-	if(gameScreenPngSize > 0)
+	if(XBuf)
 	{
+		// preview image is encoded and written in the background
 		char screenpath[1024];
 		strncpy(screenpath, filepath, 1024);
 		screenpath[strlen(screenpath)-4] = 0;
 		strcat(screenpath, ".png");
-		SaveFile((char *)gameScreenPng, screenpath, gameScreenPngSize, silent);
+		if(!QueuePngWrite(XBuf, screenpath, PNGWRITE_OVERWRITE, NULL) && !silent)
+			ErrorPrompt("Error saving preview image!");
 	}
 
-	EMUFILE_MEMFILE save(SAVEBUFFERSIZE);
-	FCEUSS_SaveMS(&save, Z_BEST_COMPRESSION);
-	datasize = save.size();
+	int level = compressSavestates ? STATE_COMPRESSION : Z_NO_COMPRESSION;
+	char storedir[1024];
 
-	if (datasize)
-		offset = SaveFile(save.buf(), filepath, datasize, silent);
+	if(GCSettings.StateStore == 1)
+		GetStoreFolder(storedir, filepath, romFilename);
 
-	if (offset > 0)
+	if(!QueueStateWrite(filepath, GCSettings.StateStore == 1 ? storedir : NULL, level, silent ? NULL : StateWritten))
 	{
-		if (!silent)
-			InfoPrompt("Save successful");
-		retval = true;
+		if(!silent)
+			ErrorPrompt("Error saving state!");
+		return false;
 	}
-	return retval;
+
+	if(silent)
+		return true;
+
+	ShowAction("Saving...");
+	WaitStateWriter();
+	CancelAction();
+
+	if(!stateWriteOk)
+	{
+		ErrorPrompt("Error saving state!");
+		return false;
+	}
+	InfoPrompt("Save successful");
+	return true;
 }
 
 bool
@@ -82,11 +112,37 @@ bool LoadState (char * filepath, bool silent)
 	if(!FindDevice(filepath, &device))
 		return 0;
 
+	WaitStateWriter(); // the state may still be being written
+
 	AllocSaveBuffer ();
 
 	offset = LoadFile(filepath, silent);
 
-	if (offset > 0)
+	if (offset > 0 && IsStoreManifest(savebuffer, offset))
+	{
+		// put the state back together from the store, whatever the setting
+		char storedir[1024];
+		u8 *state = (u8 *)memalign(32, SAVEBUFFERSIZE);
+		u32 size = 0;
+
+		GetStoreFolder(storedir, filepath, romFilename);
+
+		if(state)
+			size = StoreRead(savebuffer, offset, storedir, state, SAVEBUFFERSIZE);
+
+		if (size > 0)
+		{
+			EMUFILE_MEMFILE save(state, size);
+			FCEUSS_LoadFP(&save, SSLOADPARAM_NOBACKUP);
+			retval = true;
+		}
+		else if(!silent)
+		{
+			ErrorPrompt ("State could not be read from the store");
+		}
+		free(state);
+	}
+	else if (offset > 0)
 	{
 		EMUFILE_MEMFILE save(savebuffer, offset);
 		FCEUSS_LoadFP(&save, SSLOADPARAM_NOBACKUP);
@@ -120,13 +176,19 @@ bool SavePreviewImg (char * filepath, bool silent)
 	if(!FindDevice(filepath, &device))
 		return 0;
 
-	if(gameScreenPngSize > 0)
+	if(XBuf)
 	{
 		char screenpath[1024];
 		strncpy(screenpath, filepath, 1024);
 		screenpath[strlen(screenpath)] = 0;
 		strcat(screenpath, ".png");
-		SaveFile((char *)gameScreenPng, screenpath, gameScreenPngSize, silent);
+
+		if(!QueuePngWrite(XBuf, screenpath, PNGWRITE_OVERWRITE, NULL))
+		{
+			if(!silent)
+				ErrorPrompt("Error saving preview image!");
+			return 0;
+		}
 	}
 	
 	return 1;
@@ -16,6 +16,9 @@
 #include "gcaudio.h"
 #include "gcvideo.h"
 #include "menu.h"
+#include "filebrowser.h"
+#include "pngwriter.h"
+#include "fceux/video.h"
 
 bool turbo = false;
 bool paldeemphswap = 0;
@@ -80,9 +83,33 @@ FCEUFILE* FCEUD_OpenArchiveIndex(ArchiveScanRecord& asr, std::string &fname, int
 FCEUFILE* FCEUD_OpenArchive(ArchiveScanRecord& asr, std::string& fname, std::string* innerFilename) { return 0; }
 ArchiveScanRecord FCEUD_ScanArchive(std::string fname) { return ArchiveScanRecord(); }
 
+// Screen snapshots - the result is set by the PNG writer thread, and shown
+// by the emulation thread in FCEUD_Update
+static volatile int snapshotResult = 0; // 1 saved, -1 failed
+
+static void SnapshotWritten(const char *filepath, bool success)
+{
+	snapshotResult = success ? 1 : -1;
+}
+
+int FCEUD_SaveSnapshot(uint8 *buf)
+{
+	char filepath[1024];
+	snprintf(filepath, 1024, "%s%s/%s", pathPrefix[GCSettings.SaveMethod], GCSettings.ScreenshotsFolder, romFilename);
+	return QueuePngWrite(buf, filepath, PNGWRITE_NUMBERED, SnapshotWritten);
+}
+
 // main interface to FCE Ultra
 void FCEUD_Update(uint8 *XBuf, int32 *Buffer, int32 Count)
 {
+	int snapshot = snapshotResult;
+
+	if(snapshot)
+	{
+		snapshotResult = 0;
+		FCEU_DispMessage(snapshot > 0 ? "Screen snapshot saved." : "Error saving screen snapshot.", 0);
+	}
+
 	if(Buffer && Count > 0)
 		PlaySound(Buffer, Count); // play sound
 	if(XBuf)
@@ -105,7 +132,7 @@ void FCEUD_UpdatePulfrich(uint8 *XBuf, int32 *Buffer, int32 Count)
 		PlaySound(Buffer, Count); // play sound
 	if(XBuf) {
 		RenderStereoFrames(XBuf, XBufLeft); // output video frame
-		memcpy(XBufLeft, XBuf, sizeof(XBufLeft)); // output video frame
+		FCEU_OverlayCopy(XBufLeft); // output video frame, with the HUD on top
 	}
 	GetJoy(); // check controller input
 }
@@ -117,7 +144,7 @@ void FCEUD_UpdateLeft(uint8 *XBuf, int32 *Buffer, int32 Count)
 	if (Buffer && Count > 0)
 		PlaySound(Buffer, Count); // play sound
 	if (XBuf)
-		memcpy(XBufLeft, XBuf, sizeof(XBufLeft)); // output video frame
+		FCEU_OverlayCopy(XBufLeft); // output video frame, with the HUD on top
 	GetJoy(); // check controller input
 }
 
@@ -165,12 +192,8 @@ DUMMY(FCEUD_MovieReplayFrom)
 DUMMY(FCEUD_ToggleStatusIcon)
 DUMMY(FCEUD_DebugBreakpoint)
 DUMMY(FCEUD_SoundToggle)
-DUMMY(FCEUD_AviRecordTo)
 DUMMY(FCEUD_FlushTrace)
-DUMMY(FCEUD_AviStop)
-void FCEUI_AviVideoUpdate(const unsigned char* buffer) { }
 int FCEUD_ShowStatusIcon(void) { return 0; }
-bool FCEUI_AviIsRecording(void) { return 0; }
 bool FCEUI_AviEnableHUDrecording() { return 0; }
 void FCEUI_SetAviEnableHUDrecording(bool enable) { }
 bool FCEUI_AviDisableMovieMessages() { return true; }
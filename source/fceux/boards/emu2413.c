@@ -801,26 +801,63 @@ INLINE static int32 calc_slot_mod(OPLL_SLOT * slot) {
 	return slot->feedback;
 }
 
+/* A carrier in FINISH is silent until keyOn(), which turns on both slots of
+   the channel together and resets their phase and envelope.  keyOff() may
+   put it back in RELEASE, but its envelope is already at the bottom and it
+   drops straight back to FINISH without being heard.  So nothing the slots
+   compute meanwhile is heard and they need not run. */
+INLINE static int32 idle_channel(OPLL * opll, int32 i) {
+	return CAR(opll, i)->eg_mode == FINISH;
+}
+
 static INLINE int16 calc(OPLL * opll) {
 	int32 inst = 0, out = 0;
 	int32 i;
 
 	update_ampm(opll);
 
-	for (i = 0; i < 12; i++) {
-		calc_phase(&opll->slot[i], opll->lfo_pm);
-		calc_envelope(&opll->slot[i], opll->lfo_am);
-	}
+	for (i = 0; i < 6; i++) {
+		if (idle_channel(opll, i))
+			continue;
+
+		calc_phase(MOD(opll, i), opll->lfo_pm);
+		calc_envelope(MOD(opll, i), opll->lfo_am);
+		calc_phase(CAR(opll, i), opll->lfo_pm);
+		calc_envelope(CAR(opll, i), opll->lfo_am);
 
-	for (i = 0; i < 6; i++)
 		if (!(opll->mask & OPLL_MASK_CH(i)) && (CAR(opll, i)->eg_mode != FINISH))
 			inst += calc_slot_car(CAR(opll, i), calc_slot_mod(MOD(opll, i)));
+	}
 
 	out = inst;
 	return (int16)out;
 }
 
+/* All channels idle: only the LFOs move, by len steps at once. */
+static void skip_idle(OPLL * opll, int32 len) {
+	opll->pm_phase = (opll->pm_phase + pm_dphase * len) & (PM_DP_WIDTH - 1);
+	opll->am_phase = (opll->am_phase + am_dphase * len) & (AM_DP_WIDTH - 1);
+	opll->lfo_am = amtable[HIGHBITS(opll->am_phase, AM_DP_BITS - AM_PG_BITS)];
+	opll->lfo_pm = pmtable[HIGHBITS(opll->pm_phase, PM_DP_BITS - PM_PG_BITS)];
+}
+
 void OPLL_fillbuf(OPLL* opll, int32 *buf, int32 len, int shift) {
+	int32 i;
+
+	for (i = 0; i < 6; i++)
+		if (!idle_channel(opll, i))
+			break;
+
+	if (i == 6 && len > 0) {
+		skip_idle(opll, len);
+		while (len > 0) {
+			*buf += 32768 << shift;
+			buf++;
+			len--;
+		}
+		return;
+	}
+
 	while (len > 0) {
 		*buf += (calc(opll) + 32768) << shift;
 		buf++;
@@ -1076,3 +1113,129 @@ void OPLL_writeIO(OPLL * opll, uint32 adr, uint32 val) {
 		opll->adr = val;
 }
 
+
+#ifdef EMU2413_SELFTEST
+/* Replays a random register log through two chips, one with calc() and
+   OPLL_fillbuf() as they are and one with the original per sample loop over
+   all 12 slots, and prints the number of samples that differ (must be 0) and
+   the time each took. Both OPLL_fillbuf() and the quality mode of OPLL_calc()
+   are checked. */
+#include <time.h>
+
+static int16 calc_ref(OPLL * opll) {
+	int32 inst = 0;
+	int32 i;
+
+	update_ampm(opll);
+
+	for (i = 0; i < 12; i++) {
+		calc_phase(&opll->slot[i], opll->lfo_pm);
+		calc_envelope(&opll->slot[i], opll->lfo_am);
+	}
+
+	for (i = 0; i < 6; i++)
+		if (!(opll->mask & OPLL_MASK_CH(i)) && (CAR(opll, i)->eg_mode != FINISH))
+			inst += calc_slot_car(CAR(opll, i), calc_slot_mod(MOD(opll, i)));
+
+	return (int16)inst;
+}
+
+static int16 calc_ref_quality(OPLL * opll) {
+	while (opll->realstep > opll->oplltime) {
+		opll->oplltime += opll->opllstep;
+		opll->prev = opll->next;
+		opll->next = calc_ref(opll);
+	}
+
+	opll->oplltime -= opll->realstep;
+	opll->out = (int16)(((double)opll->next * (opll->opllstep - opll->oplltime)
+						   + (double)opll->prev * opll->oplltime) / opll->opllstep);
+
+	return (int16)opll->out;
+}
+
+void OPLL_selfTest(void) {
+	static int32 a[4096], b[4096];
+	int32 q;
+
+	for (q = 0; q < 2; q++) {
+		OPLL *opll = OPLL_new(3579545, 48000);
+		OPLL *ref = OPLL_new(3579545, 48000);
+		uint32 seed = 12345;
+		long samples = 0, diffs = 0;
+		clock_t tnew = 0, tref = 0, c;
+		int32 ev, i, n;
+
+		if (!opll || !ref)
+			return;
+
+		OPLL_reset(opll);
+		OPLL_reset(ref);
+		OPLL_set_quality(opll, q);
+		OPLL_set_quality(ref, q);
+
+#define RND() (seed = seed * 1103515245 + 12345, seed >> 8)
+		for (ev = 0; ev < 60000; ev++) {
+			uint32 r = RND() % 100, reg, val;
+
+			/* mostly key on/off and pitch, with the odd long silence
+			   where every channel is keyed off and runs out */
+			if (r < 20) {
+				for (i = 0; i < 6; i++) {
+					val = RND() & 0x0f;
+					OPLL_writeReg(opll, 0x20 + i, val);
+					OPLL_writeReg(ref, 0x20 + i, val);
+				}
+			} else {
+				if (r < 50)
+					reg = 0x20 + RND() % 6, val = RND() & 0x3f;
+				else if (r < 65)
+					reg = 0x10 + RND() % 6, val = RND() & 0xff;
+				else if (r < 80)
+					reg = 0x30 + RND() % 6, val = RND() & 0xff;
+				else
+					reg = RND() % 8, val = RND() & 0xff;
+				OPLL_writeReg(opll, reg, val);
+				OPLL_writeReg(ref, reg, val);
+			}
+			if (r >= 90 && r < 92) {
+				val = RND() & 0x3f & (RND() & 0x3f);
+				OPLL_setMask(opll, val);
+				OPLL_setMask(ref, val);
+			}
+
+			n = (RND() % 8 == 0) ? RND() % 4000 : RND() % 200;
+			memset(a, 0, n * sizeof(int32));
+			memset(b, 0, n * sizeof(int32));
+
+			c = clock();
+			if (q)
+				for (i = 0; i < n; i++) a[i] = OPLL_calc(opll);
+			else
+				OPLL_fillbuf(opll, a, n, (ev & 1) ? 1 : 4);
+			tnew += clock() - c;
+
+			c = clock();
+			for (i = 0; i < n; i++) {
+				if (q)
+					b[i] = calc_ref_quality(ref);
+				else
+					b[i] += (calc_ref(ref) + 32768) << ((ev & 1) ? 1 : 4);
+			}
+			tref += clock() - c;
+
+			for (i = 0; i < n; i++)
+				if (a[i] != b[i]) diffs++;
+			samples += n;
+		}
+#undef RND
+
+		printf("%s: %ld samples, %ld differ, %.3fs (original %.3fs)\n",
+			q ? "OPLL_calc quality" : "OPLL_fillbuf", samples, diffs,
+			(double)tnew / CLOCKS_PER_SEC, (double)tref / CLOCKS_PER_SEC);
+
+		OPLL_delete(opll);
+		OPLL_delete(ref);
+	}
+}
+#endif
@@ -143,6 +143,10 @@ uint32 OPLL_toggleMask(OPLL *, uint32 mask);
 
 void OPLL_fillbuf(OPLL* opll, int32 *buf, int32 len, int shift);
 
+#ifdef EMU2413_SELFTEST
+void OPLL_selfTest(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
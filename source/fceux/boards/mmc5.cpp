@@ -164,11 +164,15 @@ static void mmc5_PPUWrite(uint32 A, uint8 V) {
 		} else
 			PALRAM[tmp & 0x1F] = V & 0x3F;
 	} else if (tmp < 0x2000) {
-		if (PPUCHRRAM & (1 << (tmp >> 10)))
+		if (PPUCHRRAM & (1 << (tmp >> 10))) {
 			VPage[tmp >> 10][tmp] = V;
+			FCEUSS_MarkWrite(&VPage[tmp >> 10][tmp]);
+		}
 	} else {
-		if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10)))
+		if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10))) {
 			vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF] = V;
+			FCEUSS_MarkWrite(&vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF]);
+		}
 	}
 }
 
@@ -709,6 +713,7 @@ typedef struct {
 } MMC5APU;
 
 static MMC5APU MMC5Sound;
+static int32 mlevel[3];	/* HQ output levels last passed to FCEU_SoundDelta() */
 
 
 static void Do5PCM() {
@@ -725,12 +730,23 @@ static void Do5PCM() {
 			Wave[V >> 4] += MMC5Sound.raw << 1;
 }
 
+static void MMC5Level(int P, int32 ts, int32 out) {
+	if (out != mlevel[P]) {
+		FCEU_SoundDelta(ts, out - mlevel[P]);
+		mlevel[P] = out;
+	}
+}
+
 static void Do5PCMHQ() {
-	uint32 V;
-	if (!(MMC5Sound.rawcontrol & 0x40) && MMC5Sound.raw)
-		for (V = MMC5Sound.BC[2]; V < SOUNDTS; V++)
-			WaveHi[V] += MMC5Sound.raw << 5;
+	int32 V = MMC5Sound.BC[2];
+
+	if ((int32)SOUNDTS <= V) return;
 	MMC5Sound.BC[2] = SOUNDTS;
+
+	if (!(MMC5Sound.rawcontrol & 0x40) && MMC5Sound.raw)
+		MMC5Level(2, V, MMC5Sound.raw << 5);
+	else
+		MMC5Level(2, V, 0);
 }
 
 
@@ -738,7 +754,7 @@ static DECLFW(Mapper5_SW) {
 	A &= 0x1F;
 
 	GameExpSound.Fill = MMC5RunSound;
-	GameExpSound.HiFill = MMC5RunSoundHQ;
+	GameExpSound.DeltaFill = MMC5RunSoundHQ;
 
 	switch (A) {
 	case 0x10: if (psfun) psfun(); MMC5Sound.rawcontrol = V; break;
@@ -809,9 +825,12 @@ static void Do5SQ(int P) {
 
 static void Do5SQHQ(int P) {
 	static int tal[4] = { 1, 2, 4, 6 };
-	uint32 V;
+	int32 V = MMC5Sound.BC[P], end = SOUNDTS, next;
 	int32 amp, rthresh, wl;
 
+	if (end <= V) return;
+	MMC5Sound.BC[P] = end;
+
 	wl = MMC5Sound.wl[P] + 1;
 	amp = ((MMC5Sound.env[P] & 0xF) << 8);
 	rthresh = tal[(MMC5Sound.env[P] & 0xC0) >> 6];
@@ -823,19 +842,22 @@ static void Do5SQHQ(int P) {
 
 		dc = MMC5Sound.dcount[P];
 		vc = MMC5Sound.vcount[P];
-		for (V = MMC5Sound.BC[P]; V < SOUNDTS; V++) {
-			if (dc < rthresh)
-				WaveHi[V] += amp;
-			vc--;
-			if (vc <= 0) { /* Less than zero when first started. */
-				vc = wl;
-				dc = (dc + 1) & 7;
+		for (;;) {
+			MMC5Level(P, V, dc < rthresh ? amp : 0);
+			next = V + (vc > 0 ? vc : 1); /* Less than zero when first started. */
+			if (next > end) {
+				vc -= end - V;
+				break;
 			}
+			vc = wl;
+			dc = (dc + 1) & 7;
+			if ((V = next) == end)
+				break;
 		}
 		MMC5Sound.dcount[P] = dc;
 		MMC5Sound.vcount[P] = vc;
-	}
-	MMC5Sound.BC[P] = SOUNDTS;
+	} else
+		MMC5Level(P, V, 0);
 }
 
 void MMC5RunSoundHQ(void) {
@@ -875,6 +897,7 @@ void Mapper5_ESI(void) {
 	}
 	memset(MMC5Sound.BC, 0, sizeof(MMC5Sound.BC));
 	memset(MMC5Sound.vcount, 0, sizeof(MMC5Sound.vcount));
+	memset(mlevel, 0, sizeof(mlevel));
 	GameExpSound.HiSync = MMC5HiSync;
 }
 
@@ -177,7 +177,7 @@ static DECLFW(Mapper19_write) {
 				if (FSettings.SndRate) {
 					NamcoSoundHack();
 					GameExpSound.Fill = NamcoSound;
-					GameExpSound.HiFill = DoNamcoSoundHQ;
+					GameExpSound.DeltaFill = DoNamcoSoundHQ;
 					GameExpSound.HiSync = SyncHQ;
 				}
 				FixCache(dopol, V);
@@ -241,6 +241,7 @@ static void NamcoSound(int Count) {
 static uint32 PlayIndex[8];
 static int32 vcount[8];
 static int32 CVBC;
+static int32 nlevel[8];	/* HQ output levels last passed to FCEU_SoundDelta() */
 
 #define TOINDEX        (16 + 1)
 
@@ -268,34 +269,54 @@ static INLINE uint32 FetchDuff(uint32 P, uint32 envelope) {
 	return(duff);
 }
 
+static void NamcoLevel(int P, int32 ts, int32 out) {
+	if (out != nlevel[P]) {
+		FCEU_SoundDelta(ts, out - nlevel[P]);
+		nlevel[P] = out;
+	}
+}
+
+/* The channels are clocked in half cycles, and each cycle gets the sum of
+   both halves.  Only the level changes are passed on: a channel's sample
+   changes every cyclesuck half cycles, so the cycle it changes in is split
+   between the old and new sample. */
 static void DoNamcoSoundHQ(void) {
-	int32 P, V;
+	int32 P, V, c;
 	int32 cyclesuck = (((IRAM[0x7F] >> 4) & 7) + 1) * 15;
+	int32 end = SOUNDTS << 1;
 
-	for (P = 7; P >= (7 - ((IRAM[0x7F] >> 4) & 7)); P--) {
-		if ((IRAM[0x44 + (P << 3)] & 0xE0) && (IRAM[0x47 + (P << 3)] & 0xF)) {
+	if ((int32)SOUNDTS <= CVBC) return;
+
+	for (P = 0; P < 8; P++) {
+		if (P >= (7 - ((IRAM[0x7F] >> 4) & 7)) && (IRAM[0x44 + (P << 3)] & 0xE0) && (IRAM[0x47 + (P << 3)] & 0xF)) {
 			uint32 freq;
-			int32 vco;
-			uint32 duff2, lengo, envelope;
+			uint32 duff, duff2, lengo, envelope;
 
-			vco = vcount[P];
 			freq = FreqCache[P];
 			envelope = EnvCache[P];
 			lengo = LengthCache[P];
 
-			duff2 = FetchDuff(P, envelope);
-			for (V = CVBC << 1; V < (int)SOUNDTS << 1; V++) {
-				WaveHi[V >> 1] += duff2;
-				if (!vco) {
-					PlayIndex[P] += freq;
-					while ((PlayIndex[P] >> TOINDEX) >= lengo) PlayIndex[P] -= lengo << TOINDEX;
-					duff2 = FetchDuff(P, envelope);
-					vco = cyclesuck;
+			duff = FetchDuff(P, envelope);
+			NamcoLevel(P, CVBC, duff << 1);
+
+			/* V is the half cycle of the next fetch, the new sample starts after it. */
+			for (V = (CVBC << 1) + vcount[P]; V < end; V += cyclesuck) {
+				PlayIndex[P] += freq;
+				while ((PlayIndex[P] >> TOINDEX) >= lengo) PlayIndex[P] -= lengo << TOINDEX;
+				duff2 = FetchDuff(P, envelope);
+
+				c = (V + 1) >> 1;
+				if ((V + 1) & 1) {
+					NamcoLevel(P, c, duff + duff2);
+					c++;
 				}
-				vco--;
+				if (c < (int32)SOUNDTS)	/* else the next call starts with it */
+					NamcoLevel(P, c, duff2 << 1);
+				duff = duff2;
 			}
-			vcount[P] = vco;
-		}
+			vcount[P] = V - end;
+		} else
+			NamcoLevel(P, CVBC, 0);
 	}
 	CVBC = SOUNDTS;
 }
@@ -368,6 +389,7 @@ void Mapper19_ESI(void) {
 	GameExpSound.RChange = M19SC;
 	memset(vcount, 0, sizeof(vcount));
 	memset(PlayIndex, 0, sizeof(PlayIndex));
+	memset(nlevel, 0, sizeof(nlevel));
 	CVBC = 0;
 }
 
@@ -50,6 +50,7 @@ static uint8 vpsg2[4];
 static int32 cvbc[3];
 static int32 vcount[3];
 static int32 dcount[2];
+static int32 vlevel[3];
 
 static SFORMAT SStateRegs[] =
 {
@@ -254,28 +255,41 @@ static void DoSawV(void) {
 	}
 }
 
+// high-quality and band-limited modes: only the level changes are passed on
+
+static void VRC6Level(int x, int32 ts, int32 out) {
+	if (out != vlevel[x]) {
+		FCEU_SoundDelta(ts, out - vlevel[x]);
+		vlevel[x] = out;
+	}
+}
+
 static INLINE void DoSQVHQ(int x) {
-	int32 V;
+	int32 V = cvbc[x], end = SOUNDTS, next;
 	int32 amp = ((vpsg1[x << 2] & 15) << 8) * 6 / 8;
 
-	if (vpsg1[(x << 2) | 0x2] & 0x80) {
-		if (vpsg1[x << 2] & 0x80) {
-			for (V = cvbc[x]; V < (int)SOUNDTS; V++)
-				WaveHi[V] += amp;
-		} else {
-			int32 thresh = (vpsg1[x << 2] >> 4) & 7;
-			for (V = cvbc[x]; V < (int)SOUNDTS; V++) {
-				if (dcount[x] > thresh)
-					WaveHi[V] += amp;
-				vcount[x]--;
-				if (vcount[x] <= 0) {
-					vcount[x] = (vpsg1[(x << 2) | 0x1] | ((vpsg1[(x << 2) | 0x2] & 15) << 8)) + 1;
-					dcount[x] = (dcount[x] + 1) & 15;
-				}
+	if (end <= V) return;
+	cvbc[x] = end;
+
+	if (!(vpsg1[(x << 2) | 0x2] & 0x80))
+		VRC6Level(x, V, 0);
+	else if (vpsg1[x << 2] & 0x80)
+		VRC6Level(x, V, amp);
+	else {
+		int32 thresh = (vpsg1[x << 2] >> 4) & 7;
+		for (;;) {
+			VRC6Level(x, V, dcount[x] > thresh ? amp : 0);
+			next = V + (vcount[x] > 0 ? vcount[x] : 1);
+			if (next > end) {
+				vcount[x] -= end - V;
+				break;
 			}
+			vcount[x] = (vpsg1[(x << 2) | 0x1] | ((vpsg1[(x << 2) | 0x2] & 15) << 8)) + 1;
+			dcount[x] = (dcount[x] + 1) & 15;
+			if ((V = next) == end)
+				break;	/* new level starts the next span */
 		}
 	}
-	cvbc[x] = SOUNDTS;
 }
 
 static void DoSQV1HQ(void) {
@@ -289,27 +303,34 @@ static void DoSQV2HQ(void) {
 static void DoSawVHQ(void) {
 	static uint8 b3 = 0;
 	static int32 phaseacc = 0;
-	int32 V;
+	int32 V = cvbc[2], end = SOUNDTS, next;
 
-	if (vpsg2[2] & 0x80) {
-		for (V = cvbc[2]; V < (int)SOUNDTS; V++) {
-			WaveHi[V] += (((phaseacc >> 3) & 0x1f) << 8) * 6 / 8;
-			vcount[2]--;
-			if (vcount[2] <= 0) {
-				vcount[2] = (vpsg2[1] + ((vpsg2[2] & 15) << 8) + 1) << 1;
-				phaseacc += vpsg2[0] & 0x3f;
-				b3++;
-				if (b3 == 7) {
-					b3 = 0;
-					phaseacc = 0;
-				}
-			}
+	if (end <= V) return;
+	cvbc[2] = end;
+
+	if (!(vpsg2[2] & 0x80)) {
+		VRC6Level(2, V, 0);
+		return;
+	}
+	for (;;) {
+		VRC6Level(2, V, (((phaseacc >> 3) & 0x1f) << 8) * 6 / 8);
+		next = V + (vcount[2] > 0 ? vcount[2] : 1);
+		if (next > end) {
+			vcount[2] -= end - V;
+			break;
+		}
+		vcount[2] = (vpsg2[1] + ((vpsg2[2] & 15) << 8) + 1) << 1;
+		phaseacc += vpsg2[0] & 0x3f;
+		b3++;
+		if (b3 == 7) {
+			b3 = 0;
+			phaseacc = 0;
 		}
+		if ((V = next) == end)
+			break;
 	}
-	cvbc[2] = SOUNDTS;
 }
 
-
 void VRC6Sound(int Count) {
 	int x;
 
@@ -334,12 +355,13 @@ void VRC6SyncHQ(int32 ts) {
 static void VRC6_ESI(void) {
 	GameExpSound.RChange = VRC6_ESI;
 	GameExpSound.Fill = VRC6Sound;
-	GameExpSound.HiFill = VRC6SoundHQ;
 	GameExpSound.HiSync = VRC6SyncHQ;
+	GameExpSound.DeltaFill = VRC6SoundHQ;
 
 	memset(cvbc, 0, sizeof(cvbc));
 	memset(vcount, 0, sizeof(vcount));
 	memset(dcount, 0, sizeof(dcount));
+	memset(vlevel, 0, sizeof(vlevel));
 	if (FSettings.SndRate) {
 		if (FSettings.soundq >= 1) {
 			sfun[0] = DoSQV1HQ;
@@ -28,6 +28,7 @@
 
 #include "cart.h"
 #include "x6502.h"
+#include "state.h"
 
 #include "file.h"
 #include "utils/memory.h"
@@ -146,8 +147,10 @@ DECLFR(CartBR) {
 
 DECLFW(CartBW) {
 	//printf("Ok: %04x:%02x, %d\n",A,V,PRGIsRAM[A>>11]);
-	if (PRGIsRAM[A >> 11] && Page[A >> 11])
+	if (PRGIsRAM[A >> 11] && Page[A >> 11]) {
 		Page[A >> 11][A] = V;
+		FCEUSS_MarkWrite(&Page[A >> 11][A]);
+	}
 }
 
 DECLFR(CartBROB) {
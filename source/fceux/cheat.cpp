@@ -25,6 +25,7 @@
 #include "fceu.h"
 #include "file.h"
 #include "cart.h"
+#include "state.h"
 #include "driver.h"
 #include "utils/memory.h"
 
@@ -441,7 +442,10 @@ void FCEU_ApplyPeriodicCheats(void)
 	{
 		if(cur->status && !(cur->type))
 			if(CheatRPtrs[cur->addr>>10])
+			{
 				CheatRPtrs[cur->addr>>10][cur->addr]=cur->val;
+				FCEUSS_MarkWrite(&CheatRPtrs[cur->addr>>10][cur->addr]);
+			}
 		if(cur->next)
 			cur=cur->next;
 		else
@@ -137,9 +137,9 @@ void DrawMessage(bool beforeMovie)
 		guiMessage.howlong--;
 
 		if (guiMessage.linesFromBottom > 0)
-			t=XBuf+FCEU_TextScanlineOffsetFromBottom(guiMessage.linesFromBottom)+1;
+			t=XOverlay+FCEU_TextScanlineOffsetFromBottom(guiMessage.linesFromBottom)+1;
 		else
-			t=XBuf+FCEU_TextScanlineOffsetFromBottom(20)+1;
+			t=XOverlay+FCEU_TextScanlineOffsetFromBottom(20)+1;
 
 		/*
 		FCEU palette:
@@ -152,7 +152,7 @@ void DrawMessage(bool beforeMovie)
 
 		*/
 
-		if(t>=XBuf)
+		if(t>=XOverlay)
 		{
 			int color = 0x20;
 			if(guiMessage.howlong <= 40) color = 0x3C;
@@ -160,7 +160,7 @@ void DrawMessage(bool beforeMovie)
 			if(guiMessage.howlong <= 24) color = 0x21;
 			if(guiMessage.howlong <= 16) color = 0x51;
 			if(guiMessage.howlong <=  8) color = 0x41;
-			DrawTextTrans(ClipSidesOffset+t, 256, (uint8 *)guiMessage.errmsg, color+0x80);
+			DrawTextTransLayer(XOverlay, ClipSidesOffset+t, 256, (uint8 *)guiMessage.errmsg, color+0x80);
 		}
 	}
 
@@ -172,9 +172,9 @@ void DrawMessage(bool beforeMovie)
 
 		uint8 *tt;
 		subtitleMessage.howlong--;
-		tt=XBuf+FCEU_TextScanlineOffsetFromBottom(216);
+		tt=XOverlay+FCEU_TextScanlineOffsetFromBottom(216);
 
-		if(tt>=XBuf)
+		if(tt>=XOverlay)
 		{
 			int color = 0x20;
 			if(subtitleMessage.howlong == 39) color = 0x38;
@@ -182,7 +182,7 @@ void DrawMessage(bool beforeMovie)
 			if(subtitleMessage.howlong <= 20) color = 0x1C;
 			if(subtitleMessage.howlong <= 10) color = 0x11;
 			if(subtitleMessage.howlong <= 5) color = 0x1;
-			DrawTextTrans(ClipSidesOffset+tt, 256, (uint8 *)subtitleMessage.errmsg, color+0x80);
+			DrawTextTransLayer(XOverlay, ClipSidesOffset+tt, 256, (uint8 *)subtitleMessage.errmsg, color+0x80);
 		}
 	}
 }
@@ -302,12 +302,15 @@ static uint8* sline_icons[4]=
 	pause_slines
 };
 
-static void drawstatus(uint8* XBuf, int n, int y, int xofs)
+static void drawstatus(uint8* layer, int n, int y, int xofs)
 {
 	uint8* slines=sline_icons[n];
+	uint8* XBuf=layer-ClipSidesOffset;
 	int i;
 
 
+	// icon lines plus the shadow pass below
+	FCEU_OverlayMark(layer, FSettings.LastSLine - y, 17);
 	XBuf += FCEU_TextScanlineOffsetFromBottom(y) + 240 + 255 + xofs;
 	for(i=0; slines[i]!=99; i+=3)
 	{
@@ -337,17 +340,17 @@ void FCEU_DrawRecordingStatus(uint8* XBuf)
 		bool hasPlayRecIcon = false;
 		if(FCEUMOV_Mode(MOVIEMODE_RECORD))
 		{
-			drawstatus(XBuf-ClipSidesOffset,2,28,0);
+			drawstatus(XBuf,2,28,0);
 			hasPlayRecIcon = true;
 		}
 		else if(FCEUMOV_Mode(MOVIEMODE_PLAY|MOVIEMODE_FINISHED))
 		{
-			drawstatus(XBuf-ClipSidesOffset,1,28,0);
+			drawstatus(XBuf,1,28,0);
 			hasPlayRecIcon = true;
 		}
 
 		if(FCEUI_EmulationPaused())
-			drawstatus(XBuf-ClipSidesOffset,3,28,hasPlayRecIcon?-16:0);
+			drawstatus(XBuf,3,28,hasPlayRecIcon?-16:0);
 	}
 }
 
@@ -358,6 +361,7 @@ void FCEU_DrawNumberRow(uint8 *XBuf, int *nstatus, int cur)
 	int z,x,y;
 
 	XBaf=XBuf - 4 + (FSettings.LastSLine-34)*256;
+	FCEU_OverlayMark(XBuf, FSettings.LastSLine-35, 14); // rows start 4 pixels left
 	if(XBaf>=XBuf)
 		for(z=1;z<11;z++)
 		{
@@ -402,7 +406,7 @@ static int FixJoedChar(uint8 ch)
 
 char target[64][256];
 
-void DrawTextTransWH(uint8 *dest, int width, uint8 *textmsg, uint8 fgcolor, int max_w, int max_h, int border)
+void DrawTextTransWH(uint8 *layer, uint8 *dest, int width, uint8 *textmsg, uint8 fgcolor, int max_w, int max_h, int border)
 {
 	int beginx=2, x=beginx;
 	int y=2;
@@ -470,6 +474,8 @@ textoverflow:
 		max_y = 62;
 
 	// draw target buffer to screen buffer
+	if(layer)
+		FCEU_OverlayMark(layer, (int)((dest - layer) >> 8), max_y);
 	for (y = 0; y < max_y; ++y)
 	{
 		for (x = 0; x < max_x; ++x)
@@ -521,5 +527,11 @@ textoverflow:
 
 void DrawTextTrans(uint8 *dest, uint32 width, uint8 *textmsg, uint8 fgcolor)
 {
-	DrawTextTransWH(dest, width, textmsg, fgcolor, 256, 16, 2);
+	DrawTextTransWH(NULL, dest, width, textmsg, fgcolor, 256, 16, 2);
+}
+
+//same as DrawTextTrans, for text going onto a layer buffer such as XOverlay
+void DrawTextTransLayer(uint8 *layer, uint8 *dest, uint32 width, uint8 *textmsg, uint8 fgcolor)
+{
+	DrawTextTransWH(layer, dest, width, textmsg, fgcolor, 256, 16, 2);
 }
@@ -29,6 +29,24 @@ void FCEU_printf(const char *format, ...);
 //Video interface
 void FCEUD_SetPalette(uint8 index, uint8 r, uint8 g, uint8 b);
 void FCEUD_GetPalette(uint8 i,uint8 *r, uint8 *g, uint8 *b);
+#ifdef GEKKO
+//Queues a screen snapshot for background encoding.  Returns 0 on failure.
+int FCEUD_SaveSnapshot(uint8 *buf);
+//Receives the current palette in all 8 emphasis variants: 512 r,g,b triplets,
+//indexed by (deemph bits << 6) | color.  Called whenever the palette changes.
+void FCEUD_SetEmphasisPalette(const uint8 *rgb);
+#endif
+
+#ifdef GEKKO
+//Sound log output.  The driver writes the log in the background: FCEUD_WaveLogWrite()
+//only queues the data, and returns -1 once a write has failed.  FCEUD_WaveLogFlush()
+//waits for everything queued and returns the bytes that reached the file, and
+//FCEUD_WaveLogClose() then writes header over the start of the file.
+bool FCEUD_WaveLogOpen(const char *fn);
+int FCEUD_WaveLogWrite(const void *data, int size);
+int FCEUD_WaveLogFlush(void);
+void FCEUD_WaveLogClose(const void *header, int size);
+#endif
 
 //Displays an error.  Can block or not.
 void FCEUD_PrintError(const char *s);
@@ -149,8 +167,13 @@ bool FCEUI_GetUserPaletteAvail(void);
 void FCEUI_SetUserPalette(uint8 *pal, int nEntries);
 
 //Sets up sound code to render sound at the specified rate, in samples
-//per second.  Only sample rates of 44100, 48000, and 96000 are currently supported.
+//per second, clamped to FCEUI_SOUND_MINRATE through FCEUI_SOUND_MAXRATE (a
+//frame of output must fit in Wave[]).  Rates within 1% of 44100, 48000 and
+//96000 use the precomputed filters for those, other rates get a filter
+//designed when this is called.
 //If "Rate" equals 0, sound is disabled.
+#define FCEUI_SOUND_MINRATE 22050
+#define FCEUI_SOUND_MAXRATE 192000
 void FCEUI_Sound(int Rate);
 void FCEUI_SetSoundVolume(uint32 volume);
 void FCEUI_SetTriangleVolume(uint32 volume);
@@ -160,6 +183,8 @@ void FCEUI_SetNoiseVolume(uint32 volume);
 void FCEUI_SetPCMVolume(uint32 volume);
 
 void FCEUI_SetSoundQuality(int quality);
+void FCEUI_SetSoundRateAdjust(int32 ppm);
+int32 FCEUI_GetSoundRateAdjust(void);
 
 void FCEUD_SoundToggle(void);
 void FCEUD_SoundVolumeAdjust(int);
@@ -376,10 +376,12 @@ uint8 PAL = 0;
 
 static DECLFW(BRAML) {
 	RAM[A] = V;
+	FCEUSS_MarkWrite(&RAM[A]);
 }
 
 static DECLFW(BRAMH) {
 	RAM[A & 0x7FF] = V;
+	FCEUSS_MarkWrite(&RAM[A & 0x7FF]);
 }
 
 static DECLFR(ARAML) {
@@ -778,8 +780,7 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 #endif
 		if (EmulationPaused & EMULATIONPAUSED_PAUSED)
 		{
-			// emulator is paused
-			memcpy(XBuf, XBackBuf, 256*256);
+			// emulator is paused, XBuf still holds the last frame without overlays
 			FCEU_PutImage();
 			*pXBuf = XBuf;
 			*SoundBuf = WaveFinal;
@@ -880,14 +881,14 @@ void FCEUI_CloseGame(void) {
 void ResetNES(void) {
 	FCEUMOV_AddCommand(FCEUNPCMD_RESET);
 	if (!GameInfo) return;
+	FCEUSS_InvalidateCaptures();
 	GameInterface(GI_RESETM2);
 	FCEUSND_Reset();
 	FCEUPPU_Reset();
 	X6502_Reset();
 
-	// clear back baffer
-	extern uint8 *XBackBuf;
-	memset(XBackBuf, 0, 256 * 256);
+	// clear frame buffer
+	memset(XBuf, 0, 256 * 256);
 
 	FCEU_DispMessage("", 0); //FCEU_DispMessage("Reset", 0);
 }
@@ -977,6 +978,7 @@ void hand(X6502 *X, int type, uint32 A) {
 void PowerNES(void) {
 	FCEUMOV_AddCommand(FCEUNPCMD_POWER);
 	if (!GameInfo) return;
+	FCEUSS_InvalidateCaptures();
 
 	//reseed random, unless we're in a movie
 	extern int disableBatteryLoading;
@@ -1025,9 +1027,8 @@ void PowerNES(void) {
 #endif
 	FCEU_PowerCheats();
 	LagCounterReset();
-	// clear back buffer
-	extern uint8 *XBackBuf;
-	memset(XBackBuf, 0, 256 * 256);
+	// clear frame buffer
+	memset(XBuf, 0, 256 * 256);
 
 #ifdef __WIN_DRIVER__
 	Update_RAM_Search(); // Update_RAM_Watch() is also called.
@@ -495,30 +495,37 @@ static INLINE void ClockFall(void) {
 	clockcount = (clockcount + 1) & 7;
 }
 
+static INLINE void FDSDoClock(void) {
+	fdso.count -= (int64)1 << 40;
+	ClockRise();
+	ClockFall();
+	fdso.envcount--;
+	if (fdso.envcount <= 0) {
+		fdso.envcount += SPSG[0xA] * 3;
+		DoEnv();
+	}
+}
+
+static INLINE int32 FDSOutput(void) {
+	// Might need to emulate applying the amplitude to the waveform a bit better...
+	int k = amplitude[0];
+	if (k > 0x20) k = 0x20;
+	return (fdso.cwave[b24latch68 >> 19] * k) * 4 / ((SPSG[0x9] & 0x3) + 2);
+}
+
 static INLINE int32 FDSDoSound(void) {
 	fdso.count += fdso.cycles;
 	if (fdso.count >= ((int64)1 << 40)) {
  dogk:
-		fdso.count -= (int64)1 << 40;
-		ClockRise();
-		ClockFall();
-		fdso.envcount--;
-		if (fdso.envcount <= 0) {
-			fdso.envcount += SPSG[0xA] * 3;
-			DoEnv();
-		}
+		FDSDoClock();
 	}
 	if (fdso.count >= 32768) goto dogk;
 
-	// Might need to emulate applying the amplitude to the waveform a bit better...
-	{
-		int k = amplitude[0];
-		if (k > 0x20) k = 0x20;
-		return (fdso.cwave[b24latch68 >> 19] * k) * 4 / ((SPSG[0x9] & 0x3) + 2);
-	}
+	return FDSOutput();
 }
 
 static int32 FBC = 0;
+static int32 flevel = 0;	// HQ output level last passed to FCEU_SoundDelta()
 
 static void RenderSound(void) {
 	int32 end, start;
@@ -539,16 +546,45 @@ static void RenderSound(void) {
 		}
 }
 
+static void FDSLevel(int32 ts, uint32 t) {
+	t += t >> 1;
+	if ((int32)t != flevel) {
+		FCEU_SoundDelta(ts, t - flevel);
+		flevel = t;
+	}
+}
+
+// The output only changes when the channel is clocked, so step from one
+// clock to the next instead of calling FDSDoSound() every cycle.
 static void RenderSoundHQ(void) {
-	uint32 x; //mbg merge 7/17/06 - made this unsigned
+	int32 x = FBC, end = SOUNDTS;
+	int64 n;
 
-	if (!(SPSG[0x9] & 0x80))
-		for (x = FBC; x < SOUNDTS; x++) {
-			uint32 t = FDSDoSound();
-			t += t >> 1;
-			WaveHi[x] += t; //(t<<2)-(t<<1);
+	if (end <= x)
+		return;
+	FBC = end;
+
+	if (SPSG[0x9] & 0x80) {
+		FDSLevel(x, 0);
+		return;
+	}
+
+	FDSLevel(x, FDSOutput());
+	for (;;) {
+		// cycles up to and including the next one that clocks
+		n = (32768 - fdso.count + fdso.cycles - 1) / fdso.cycles;
+		if (n < 1) n = 1;
+		if (x + n > end) {
+			fdso.count += (end - x) * fdso.cycles;
+			break;
 		}
-	FBC = SOUNDTS;
+		fdso.count += n * fdso.cycles;
+		x += n - 1;
+		while (fdso.count >= 32768)
+			FDSDoClock();
+		FDSLevel(x, FDSOutput());
+		x++;
+	}
 }
 
 static void HQSync(int32 ts) {
@@ -561,6 +597,7 @@ void FDSSound(int c) {
 }
 
 static void FDS_ESI(void) {
+	flevel = 0;
 	if (FSettings.SndRate) {
 		if (FSettings.soundq >= 1) {
 			fdso.cycles = (int64)1 << 39;
@@ -579,7 +616,7 @@ void FDSSoundReset(void) {
 	memset(&fdso, 0, sizeof(fdso));
 	FDS_ESI();
 	GameExpSound.HiSync = HQSync;
-	GameExpSound.HiFill = RenderSoundHQ;
+	GameExpSound.DeltaFill = RenderSoundHQ;
 	GameExpSound.Fill = FDSSound;
 	GameExpSound.RChange = FDS_ESI;
 }
@@ -12,12 +12,39 @@
 
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 
-static int32 sq2coeffs[SQ2NCOEFFS];
-static int32 coeffs[NCOEFFS];
+/* Room for the longer filters designed for rates below 44100hz. */
+static int32 sq2coeffs[SQ2NCOEFFS*2];
+static int32 coeffs[NCOEFFS*2];
+static uint32 ncoeffs;		/* Taps in the current filter. */
 
 static uint32 mrindex;
 static uint32 mrratio;
+static uint32 mrratiobase;	/* mrratio at the nominal sound rate. */
+static int32 mradjust;		/* Dynamic rate control, parts per million. */
+
+/* Band-limited step synthesis (soundq 3).  Instead of filling WaveHi every
+   CPU cycle, the channels pass the changes of their output level to
+   BlipAddDelta().  Each change is added to blipbuf at the output rate as the
+   difference of a band-limited step (a windowed sinc, picked from BLIP_PHASES
+   sub-sample positions), and BlipFilterSound() integrates the buffer into
+   output samples.
+*/
+#define BLIP_FRAC_BITS 20		/* Output sample position, 12.20 fixed point. */
+#define BLIP_PHASE_BITS 6
+#define BLIP_PHASES (1<<BLIP_PHASE_BITS)
+#define BLIP_HALF 8
+#define BLIP_WIDTH (BLIP_HALF*2)
+#define BLIP_UNIT_BITS 14		/* Each kernel phase sums to 1<<BLIP_UNIT_BITS. */
+
+static int16 blipkernel[BLIP_PHASES][BLIP_WIDTH];
+static uint32 blipbuf[4096+512+BLIP_WIDTH];	/* uint32 so that the sums can wrap. */
+static uint32 blipsum;
+static uint32 blipfactor;	/* Output samples per CPU cycle. */
+static uint32 blipoffset;
 
 void SexyFilter2(int32 *in, int32 count)
 {
@@ -93,12 +120,62 @@ void SexyFilter(int32 *in, int32 *out, int32 count)
    code to be higher, or you *might* overflow the FIR code.
 */
 
+/* One output sample: the FIR at input sample x>>16 and at the next input sample,
+   linearly interpolated by the fraction of x.  Both taps are evaluated in one
+   pass - the second tap sees the same inputs one sample later, so every input
+   sample is loaded once and shared.  Unrolled by 4 (NCOEFFS and SQ2NCOEFFS are
+   multiples of 4).  Gives exactly the same results as the original separate
+   loop over each tap (NeoFilterTapRef, built with FILTER_SELFTEST).
+*/
+static INLINE int32 NeoFilterTap(const int32 *in, uint32 x, const int32 *D, uint32 ncoeffs)
+{
+	const int32 *S=&in[x>>16];
+	int32 acc=0,acc2=0;
+	int32 hi=S[1];
+
+	for(uint32 c=ncoeffs;c;c-=4,D+=4,S-=4)
+	{
+		int32 s0=S[0],s1=S[-1],s2=S[-2],s3=S[-3];
+
+		acc+=(s0*D[0])>>6;
+		acc2+=(hi*D[0])>>6;
+		acc+=(s1*D[1])>>6;
+		acc2+=(s0*D[1])>>6;
+		acc+=(s2*D[2])>>6;
+		acc2+=(s1*D[2])>>6;
+		acc+=(s3*D[3])>>6;
+		acc2+=(s2*D[3])>>6;
+		hi=s3;
+	}
+
+	return ((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
+}
+
+#ifdef FILTER_SELFTEST
+/* The original two-tap loop, kept to check NeoFilterTap against. */
+static int32 NeoFilterTapRef(const int32 *in, uint32 x, const int32 *D, uint32 ncoeffs)
+{
+	int32 acc=0,acc2=0;
+	unsigned int c;
+	const int32 *S;
+
+	for(c=ncoeffs,S=&in[(x>>16)-ncoeffs];c;c--,D++)
+	{
+		acc+=(S[c]**D)>>6;
+		acc2+=(S[1+c]**D)>>6;
+	}
+
+	return ((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
+}
+#endif
+
 int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
 {
 	uint32 x;
 	uint32 max;
 	int32 *outsave=out;
 	int32 count=0;
+	const int32 *D;
 
 //	for(x=0;x<inlen;x++)
 //	{
@@ -107,55 +184,67 @@ int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
         max=(inlen-1)<<16;
 
 	if(FSettings.soundq==2)
-        for(x=mrindex;x<max;x+=mrratio)
-        {
-			int32 acc=0,acc2=0;
-			unsigned int c;
-			int32 *S,*D;
-
-			for(c=SQ2NCOEFFS,S=&in[(x>>16)-SQ2NCOEFFS],D=sq2coeffs;c;c--,D++)
-			{
-				acc+=(S[c]**D)>>6;
-				acc2+=(S[1+c]**D)>>6;
-			}
-
-			acc=((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
-			*out=acc;
-			out++;
-			count++;
-        }
+		D=sq2coeffs;
 	else
-		for(x=mrindex;x<max;x+=mrratio)
-		{
-			int32 acc=0,acc2=0;
-			unsigned int c;
-			const int32 *S,*D;
-
-			for(c=NCOEFFS,S=&in[(x>>16)-NCOEFFS],D=coeffs;c;c--,D++)
-			{
-				acc+=(S[c]**D)>>6;
-				acc2+=(S[1+c]**D)>>6;
-			}
-
-			acc=((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
-			*out=acc;
-			out++;
-			count++;
-		}
+		D=coeffs;
+
+	for(x=mrindex;x<max;x+=mrratio)
+	{
+		*out=NeoFilterTap(in,x,D,ncoeffs);
+		out++;
+		count++;
+	}
 
 	mrindex=x-max;
+	mrindex+=ncoeffs*65536;
+	*leftover=ncoeffs+1;
+
+	if(GameExpSound.NeoFill)
+	 GameExpSound.NeoFill(outsave,count);
+
+	SexyFilter(outsave,outsave,count);
+	if(FSettings.lowpass)
+	 SexyFilter2(outsave,count);
+	return(count);
+}
+
+/* NeoFilterSound() for a frame in which every input sample, including the
+   leftover from the previous frame, is dc.  Both taps of the FIR then see
+   the same inputs, so every output sample is the same value and the filter
+   only has to be evaluated once.  The resampling position, the leftover and
+   the high-pass filters carry on exactly as after NeoFilterSound().
+*/
+int32 NeoFilterDC(int32 dc, int32 *out, uint32 inlen, int32 *leftover)
+{
+	uint32 x;
+	uint32 max;
+	int32 *outsave=out;
+	int32 count=0;
+	int32 acc=0;
+	const int32 *D;
+
+        max=(inlen-1)<<16;
 
 	if(FSettings.soundq==2)
-	{
-         mrindex+=SQ2NCOEFFS*65536;
-         *leftover=SQ2NCOEFFS+1;
-	}
+		D=sq2coeffs;
 	else
+		D=coeffs;
+
+	for(x=0;x<ncoeffs;x++)
+	 acc+=(dc*D[x])>>6;
+	acc=((int64)acc*65536)>>(16+11);
+
+	for(x=mrindex;x<max;x+=mrratio)
 	{
-         mrindex+=NCOEFFS*65536;
-         *leftover=NCOEFFS+1;
+		*out=acc;
+		out++;
+		count++;
 	}
 
+	mrindex=x-max;
+	mrindex+=ncoeffs*65536;
+	*leftover=ncoeffs+1;
+
 	if(GameExpSound.NeoFill)
 	 GameExpSound.NeoFill(outsave,count);
 
@@ -165,6 +254,170 @@ int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
 	return(count);
 }
 
+void BlipAddDelta(uint32 ts, int32 delta)
+{
+	uint32 pos=blipoffset+ts*blipfactor;
+	uint32 *out=&blipbuf[pos>>BLIP_FRAC_BITS];
+	const int16 *k=blipkernel[(pos>>(BLIP_FRAC_BITS-BLIP_PHASE_BITS))&(BLIP_PHASES-1)];
+
+	for(int x=0;x<BLIP_WIDTH;x+=4)
+	{
+		out[x]+=delta*k[x];
+		out[x+1]+=delta*k[x+1];
+		out[x+2]+=delta*k[x+2];
+		out[x+3]+=delta*k[x+3];
+	}
+}
+
+/* Returns the number of samples written to out, for the inlen CPU cycles
+   since the last call.
+*/
+int32 BlipFilterSound(int32 *out, uint32 inlen)
+{
+	uint32 pos=blipoffset+inlen*blipfactor;
+	int32 count=pos>>BLIP_FRAC_BITS;
+
+	/* Scaled by 8, the DC gain of the FIR tables, so that SexyFilter()
+	   sets the same volume as in high quality mode. */
+	for(int32 x=0;x<count;x++)
+	{
+		blipsum+=blipbuf[x];
+		out[x]=(int32)blipsum>>(BLIP_UNIT_BITS-3);
+	}
+
+	memmove(blipbuf,blipbuf+count,BLIP_WIDTH*sizeof(uint32));
+	memset(blipbuf+BLIP_WIDTH,0,count*sizeof(uint32));
+	blipoffset=pos&((1<<BLIP_FRAC_BITS)-1);
+
+	if(GameExpSound.NeoFill)
+	 GameExpSound.NeoFill(out,count);
+
+	SexyFilter(out,out,count);
+	if(FSettings.lowpass)
+	 SexyFilter2(out,count);
+	return(count);
+}
+
+static void SetResampleRatio(void)
+{
+ mrratio=mrratiobase+(int64)mrratiobase*mradjust/1000000;
+ blipfactor=((uint64)1<<(16+BLIP_FRAC_BITS))/mrratio;
+}
+
+/* Stretches the input to output ratio by ppm parts per million, without
+   resetting the filter state.  Positive values give fewer output samples.
+*/
+void FilterRateAdjust(int32 ppm)
+{
+ mradjust=ppm;
+ if(mrratiobase)
+  SetResampleRatio();
+}
+
+static void MakeBlipKernel(void)
+{
+ for(int p=0;p<BLIP_PHASES;p++)
+ {
+  double h[BLIP_WIDTH];
+  double sum=0;
+  int32 total=0;
+  int mid=BLIP_HALF;
+
+  for(int x=0;x<BLIP_WIDTH;x++)
+  {
+   /* Distance from the step, in output samples; cut off at 90% of Nyquist. */
+   double t=x-BLIP_HALF-(double)p/BLIP_PHASES;
+   double s=t==0?1:sin(M_PI*0.9*t)/(M_PI*0.9*t);
+   double w=fabs(t)<BLIP_HALF?0.42+0.5*cos(M_PI*t/BLIP_HALF)+0.08*cos(2*M_PI*t/BLIP_HALF):0;
+   h[x]=s*w;
+   sum+=h[x];
+  }
+
+  for(int x=0;x<BLIP_WIDTH;x++)
+  {
+   blipkernel[p][x]=(int16)floor(h[x]*(1<<BLIP_UNIT_BITS)/sum+0.5);
+   total+=blipkernel[p][x];
+   if(blipkernel[p][x]>blipkernel[p][mid]) mid=x;
+  }
+  /* Every step must add up to exactly its delta, or the output drifts. */
+  blipkernel[p][mid]+=(1<<BLIP_UNIT_BITS)-total;
+ }
+}
+
+/* Runtime filter design, for output rates without a table in fir/
+   (FCEUI_SOUND_MINRATE to FCEUI_SOUND_MAXRATE).  A Kaiser windowed sinc at
+   the CPU rate, with the stopband starting at the output rate's Nyquist
+   frequency, like the Parks-McClellan tables.  The number of taps is scaled
+   with the rate below 44100hz and above 96000hz, so the filtering costs about
+   the same per second.
+*/
+static double BesselI0(double x)
+{
+ double sum=1,term=1;
+
+ for(int k=1;term>sum*1e-12;k++)
+ {
+  term*=(x*x/4)/((double)k*k);
+  sum+=term;
+ }
+ return(sum);
+}
+
+static uint32 DesignTaps(uint32 base, int32 rate)
+{
+ uint32 n=base;
+
+ if(rate<44100)
+  n=(uint64)base*44100/rate;
+ else if(rate>96000)
+  n=(uint64)base*96000/rate;
+
+ n=(n+3)&~3;	/* NeoFilterTap() runs 4 taps at a time. */
+ if(n>base*2) n=base*2;
+ if(n<16) n=16;
+ return(n);
+}
+
+/* atten is the stopband attenuation in dB.  DC gain is 8, as in fir/. */
+static void DesignFilter(int32 *D, uint32 n, double cpu, int32 rate, double atten)
+{
+ static double h[SQ2NCOEFFS];
+ double beta=0.1102*(atten-8.7);
+ double width=(atten-8)*cpu/(2.285*2*M_PI*(n-1));
+ double fc=rate/2.0-width/2;
+ double sum=0;
+ uint32 x;
+
+ /* Passing more would make the taps too large for the >>6 products
+    in NeoFilterTap(). */
+ if(fc>44100) fc=44100;
+
+ for(x=0;x<n>>1;x++)
+ {
+  double t=x-(n-1)/2.0;
+  double r=2*t/(n-1);
+
+  h[x]=sin(2*M_PI*fc/cpu*t)/(M_PI*t)*BesselI0(beta*sqrt(1-r*r))/BesselI0(beta);
+  sum+=h[x]*2;
+ }
+
+ for(x=0;x<n>>1;x++)
+  D[x]=D[n-1-x]=(int32)floor(h[x]*(1<<20)/sum+0.5);
+}
+
+/* The table rate within 1% of rate, or 0.  Drivers that tune the rate to
+   their video timing (the Wii runs at 48070hz to 48220hz) keep the shipped
+   tables; their stopband moves by at most 1% of Nyquist. */
+static int32 TableRate(int32 rate)
+{
+ static const int32 tabrates[3]={44100,48000,96000};
+
+ for(int x=0;x<3;x++)
+  if(rate*100>=tabrates[x]*99 && rate*100<=tabrates[x]*101)
+   return(tabrates[x]);
+ return(0);
+}
+
 void MakeFilters(int32 rate)
 {
  const int32 *tabs[6]={C44100NTSC,C44100PAL,C48000NTSC,C48000PAL,C96000NTSC,
@@ -172,29 +425,68 @@ void MakeFilters(int32 rate)
  const int32 *sq2tabs[6]={SQ2C44100NTSC,SQ2C44100PAL,SQ2C48000NTSC,SQ2C48000PAL,
 	SQ2C96000NTSC,SQ2C96000PAL};
 
+ static int32 designrate=0;
+ static double designcpu;
+ static int designq;
+ double cpu=PAL?PAL_CPU:NTSC_CPU;
  const int32 *tmp;
+ int32 *D;
  int32 x;
+ int32 tabrate;
  uint32 nco;
 
  if(FSettings.soundq==2)
+ {
+  D=sq2coeffs;
   nco=SQ2NCOEFFS;
+ }
  else
+ {
+  D=coeffs;
   nco=NCOEFFS;
+ }
 
- mrindex=(nco+1)<<16;
- mrratio=(PAL?(int64)(PAL_CPU*65536):(int64)(NTSC_CPU*65536))/rate;
+ mrratiobase=(PAL?(int64)(PAL_CPU*65536):(int64)(NTSC_CPU*65536))/rate;
+ SetResampleRatio();
 
- if(FSettings.soundq==2)
-  tmp=sq2tabs[(PAL?1:0)|(rate==48000?2:0)|(rate==96000?4:0)];
- else
-  tmp=tabs[(PAL?1:0)|(rate==48000?2:0)|(rate==96000?4:0)];
+ if(FSettings.soundq==3)
+ {
+  MakeBlipKernel();
+  memset(blipbuf,0,sizeof(blipbuf));
+  blipsum=0;
+  blipoffset=0;
+  return;
+ }
 
- if(FSettings.soundq==2)
-  for(x=0;x<SQ2NCOEFFS>>1;x++)
-   sq2coeffs[x]=sq2coeffs[SQ2NCOEFFS-1-x]=tmp[x];
+ if((tabrate=TableRate(rate)))
+ {
+  if(FSettings.soundq==2)
+   tmp=sq2tabs[(PAL?1:0)|(tabrate==48000?2:0)|(tabrate==96000?4:0)];
+  else
+   tmp=tabs[(PAL?1:0)|(tabrate==48000?2:0)|(tabrate==96000?4:0)];
+
+  for(x=0;x<(int32)nco>>1;x++)
+   D[x]=D[nco-1-x]=tmp[x];
+
+  ncoeffs=nco;
+  if(designq==(FSettings.soundq==2))
+   designrate=0;
+ }
  else
-  for(x=0;x<NCOEFFS>>1;x++)
-   coeffs[x]=coeffs[NCOEFFS-1-x]=tmp[x];
+ {
+  ncoeffs=DesignTaps(nco,rate);
+
+  /* Reuse the last design if nothing changed. */
+  if(rate!=designrate || cpu!=designcpu || designq!=(FSettings.soundq==2))
+  {
+   DesignFilter(D,ncoeffs,cpu,rate,FSettings.soundq==2?75:60);
+   designrate=rate;
+   designcpu=cpu;
+   designq=(FSettings.soundq==2);
+  }
+ }
+
+ mrindex=(ncoeffs+1)<<16;
 
  #ifdef MOO
  /* Some tests involving precision and error. */
@@ -207,3 +499,121 @@ void MakeFilters(int32 rate)
  }
  #endif
 }
+
+#ifdef FILTER_SELFTEST
+/* Runs NeoFilterTap against the original loop for every coefficient table,
+   over a second of noisy square waves at the CPU rate (in frame sized blocks,
+   as FCEU_SoundCPUHook does), and prints the largest difference (the allowed
+   error is 0) and the time each one took.
+*/
+static double FilterGain(const int32 *D, uint32 n, double cpu, double freq)
+{
+ double re=0,im=0,dc=0;
+
+ for(uint32 x=0;x<n;x++)
+ {
+  re+=D[x]*cos(2*M_PI*freq/cpu*x);
+  im+=D[x]*sin(2*M_PI*freq/cpu*x);
+  dc+=D[x];
+ }
+ return(20*log10(sqrt(re*re+im*im)/dc+1e-12));
+}
+
+/* The -6 dB point, and the worst attenuation from the output rate's Nyquist
+   frequency up to 3 times the output rate (everything above Nyquist aliases). */
+static void FilterResponse(const int32 *D, uint32 n, double cpu, int32 rate, double *edge, double *stop)
+{
+ double f;
+
+ for(f=0;f<rate/2 && FilterGain(D,n,cpu,f)>-6;f+=25) {}
+ *edge=f;
+
+ *stop=-1000;
+ for(f=rate/2;f<rate*3;f+=100)
+ {
+  double g=FilterGain(D,n,cpu,f);
+  if(g>*stop) *stop=g;
+ }
+}
+
+void FCEU_FilterSelfTest(void)
+{
+ static const int32 *tabs[12]={C44100NTSC,C44100PAL,C48000NTSC,C48000PAL,C96000NTSC,C96000PAL,
+	SQ2C44100NTSC,SQ2C44100PAL,SQ2C48000NTSC,SQ2C48000PAL,SQ2C96000NTSC,SQ2C96000PAL};
+ static const char *names[6]={"44100 NTSC","44100 PAL","48000 NTSC","48000 PAL","96000 NTSC","96000 PAL"};
+ static const int32 rates[6]={44100,44100,48000,48000,96000,96000};
+ const uint32 inlen=1789773, blocklen=32768;
+ int32 *in=(int32*)malloc((inlen+1)*sizeof(int32));
+ int32 *a=(int32*)malloc((inlen/16+1)*sizeof(int32));
+ int32 *b=(int32*)malloc((inlen/16+1)*sizeof(int32));
+ uint32 seed=1;
+
+ if(in && a && b)
+ {
+  for(uint32 x=0;x<=inlen;x++)
+  {
+   seed=seed*1103515245+12345;
+   in[x]=((x/40)&1?6000:-6000)+(int32)((seed>>16)&4095)-2048;
+  }
+
+  for(int t=0;t<12;t++)
+  {
+   uint32 nco=t<6?NCOEFFS:SQ2NCOEFFS;
+   int32 *D=t<6?coeffs:sq2coeffs;
+   uint32 ratio=(t&1?(int64)(PAL_CPU*65536):(int64)(NTSC_CPU*65536))/rates[t%6];
+   uint32 max=(blocklen-1)<<16;
+   int32 maxerr=0;
+   int n=0;
+   uint32 block;
+
+   for(uint32 x=0;x<nco>>1;x++)
+    D[x]=D[nco-1-x]=tabs[t][x];
+
+   clock_t c0=clock();
+   for(block=0;block+blocklen<=inlen;block+=blocklen)
+    for(uint32 x=(nco+1)<<16;x<max;x+=ratio)
+     a[n++]=NeoFilterTap(in+block,x,D,nco);
+   clock_t c1=clock();
+   n=0;
+   for(block=0;block+blocklen<=inlen;block+=blocklen)
+    for(uint32 x=(nco+1)<<16;x<max;x+=ratio)
+     b[n++]=NeoFilterTapRef(in+block,x,D,nco);
+   clock_t c2=clock();
+
+   for(int i=0;i<n;i++)
+   {
+    int32 e=abs(a[i]-b[i]);
+    if(e>maxerr) maxerr=e;
+   }
+
+   FCEU_printf("%s %s: %d samples, max error %d, %ld vs %ld clocks\n",t<6?"NCOEFFS":"SQ2NCOEFFS",
+    names[t%6],n,maxerr,(long)(c1-c0),(long)(c2-c1));
+  }
+ }
+
+ free(in);
+ free(a);
+ free(b);
+
+ /* Compare the runtime designs with the tables at the same rates. */
+ for(int t=0;t<12;t++)
+ {
+  static int32 D[SQ2NCOEFFS];
+  uint32 nco=t<6?NCOEFFS:SQ2NCOEFFS;
+  double cpu=t&1?PAL_CPU:NTSC_CPU;
+  double ship6,shipstop,des6,desstop;
+
+  for(uint32 x=0;x<nco>>1;x++)
+   D[x]=D[nco-1-x]=tabs[t][x];
+  FilterResponse(D,nco,cpu,rates[t%6],&ship6,&shipstop);
+
+  DesignFilter(D,DesignTaps(nco,rates[t%6]),cpu,rates[t%6],t<6?60:75);
+  FilterResponse(D,DesignTaps(nco,rates[t%6]),cpu,rates[t%6],&des6,&desstop);
+
+  FCEU_printf("%s %s: -6 dB at %.0f / %.0f hz, stopband %.1f / %.1f dB (fir/ / designed)\n",
+   t<6?"NCOEFFS":"SQ2NCOEFFS",names[t%6],ship6,des6,shipstop,desstop);
+ }
+
+ MakeFilters(FSettings.SndRate);
+}
+#endif
@@ -1,4 +1,11 @@
 int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover);
+int32 NeoFilterDC(int32 dc, int32 *out, uint32 inlen, int32 *leftover);
 void MakeFilters(int32 rate);
+void FilterRateAdjust(int32 ppm);
 void SexyFilter(int32 *in, int32 *out, int32 count);
 void SexyFilter2(int32 *in, int32 count);
+void BlipAddDelta(uint32 ts, int32 delta);
+int32 BlipFilterSound(int32 *out, uint32 inlen);
+#ifdef FILTER_SELFTEST
+void FCEU_FilterSelfTest(void);
+#endif
@@ -1,4 +1,5 @@
 #include "share.h"
+#include "../video.h"
 
 static uint8 GunSight[]={
         0,0,0,0,0,0,1,0,0,0,0,0,0,
@@ -43,6 +44,7 @@ void FCEU_DrawGunSight(uint8 *buf, int xc, int yc)
  int x,y;
  int c,d;
 
+  FCEU_OverlayMark(buf, yc-6, 13);
   for(y=0;y<13;y++)
    for(x=0;x<13;x++)
    {
@@ -69,6 +71,7 @@ void FCEU_DrawCursor(uint8 *buf, int xc, int yc)
  int x,y;
  int c,d;
 
+  FCEU_OverlayMark(buf, yc, 19);
   if(xc<256 && yc<240)
   for(y=0;y<19;y++)
    for(x=0;x<11;x++)
@@ -1433,7 +1433,7 @@ void FCEU_DrawMovies(uint8 *XBuf)
 			sprintf(counterbuf,"%d (no movie)",currFrameCounter);
 
 		if (counterbuf[0])
-			DrawTextTrans(ClipSidesOffset+XBuf+FCEU_TextScanlineOffsetFromBottom(30)+1, 256, (uint8*)counterbuf, color+0x80);
+			DrawTextTransLayer(XBuf, ClipSidesOffset+XBuf+FCEU_TextScanlineOffsetFromBottom(30)+1, 256, (uint8*)counterbuf, color+0x80);
 	}
 	if (rerecord_display && movieMode != MOVIEMODE_INACTIVE)
 	{
@@ -1441,7 +1441,7 @@ void FCEU_DrawMovies(uint8 *XBuf)
 		sprintf(counterbuf, "%d", currMovieData.rerecordCount);
 
 		if (counterbuf[0])
-			DrawTextTrans(ClipSidesOffset+XBuf+FCEU_TextScanlineOffsetFromBottom(50)+1, 256, (uint8*)counterbuf, 0x28+0x80);
+			DrawTextTransLayer(XBuf, ClipSidesOffset+XBuf+FCEU_TextScanlineOffsetFromBottom(50)+1, 256, (uint8*)counterbuf, 0x28+0x80);
 	}
 }
 
@@ -1453,7 +1453,7 @@ void FCEU_DrawLagCounter(uint8 *XBuf)
 		uint8 color = (lagFlag) ? (0x16+0x80) : (0x2A+0x80);
 		sprintf(lagcounterbuf, "%d", lagCounter);
 		if(lagcounterbuf[0])
-			DrawTextTrans(ClipSidesOffset + XBuf + FCEU_TextScanlineOffsetFromBottom(40) + 1, 256, (uint8*)lagcounterbuf, color);
+			DrawTextTransLayer(XBuf, ClipSidesOffset + XBuf + FCEU_TextScanlineOffsetFromBottom(40) + 1, 256, (uint8*)lagcounterbuf, color);
 	}
 }
 
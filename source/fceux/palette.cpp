@@ -29,6 +29,7 @@
 #endif
 
 #include "palette.h"
+#include "video.h"
 #include "palettes/palettes.h"
 
 #ifndef M_PI
@@ -175,9 +176,12 @@ int bisqwit_clamp(int v) { return v<0 ? 0 : v>255 ? 255 : v; }
 // Calculate the luma and chroma by emulating the relevant circuits:
 int bisqwit_wave(int p, int color) { return (color+p+8)%12 < 6; }
 
-static void ApplyDeemphasisBisqwit(int entry, u8& r, u8& g, u8& b)
+//the bisqwit deemph scale factors only depend on the entry, so they're generated once (512 entries x 2 passes x 12 cycles of pow/sin/cos)
+static float bisqwit_scale[64*8][3];
+static bool bisqwit_scale_ready = false;
+
+static void GenerateBisqwitScale(int entry)
 {
-	if(entry<64) return;
 	int myr=0, myg=0, myb=0;
 	// The input value is a NES color index (with de-emphasis bits).
 	// We need RGB values. Convert the index into RGB.
@@ -238,18 +242,29 @@ static void ApplyDeemphasisBisqwit(int entry, u8& r, u8& g, u8& b)
 		if(pass==0) myr = rt, myg = gt, myb = bt;
 		else
 		{
-			float rscale = (float)rt / myr;
-			float gscale = (float)gt / myg;
-			float bscale = (float)bt / myb;
-			#define BCLAMP(x) ((x)<0?0:((x)>255?255:(x)))
-			if(myr!=0) r = (u8)(BCLAMP(r*rscale));
-			if(myg!=0) g = (u8)(BCLAMP(g*gscale));
-			if(myb!=0) b = (u8)(BCLAMP(b*bscale));
+			//a scale of 1 leaves the component alone
+			bisqwit_scale[entry][0] = myr!=0 ? (float)rt / myr : 1.0f;
+			bisqwit_scale[entry][1] = myg!=0 ? (float)gt / myg : 1.0f;
+			bisqwit_scale[entry][2] = myb!=0 ? (float)bt / myb : 1.0f;
 		}
 	}
+}
 
+static void ApplyDeemphasisBisqwit(int entry, u8& r, u8& g, u8& b)
+{
+	if(entry<64) return;
 
+	if(!bisqwit_scale_ready)
+	{
+		for(int i=64;i<64*8;i++)
+			GenerateBisqwitScale(i);
+		bisqwit_scale_ready = true;
+	}
 
+	#define BCLAMP(x) ((x)<0?0:((x)>255?255:(x)))
+	r = (u8)(BCLAMP(r*bisqwit_scale[entry][0]));
+	g = (u8)(BCLAMP(g*bisqwit_scale[entry][1]));
+	b = (u8)(BCLAMP(b*bisqwit_scale[entry][2]));
 }
 
 //classic algorithm
@@ -489,6 +504,9 @@ static void CalculatePalette(void)
 			palette_ntsc[(x<<4)+z].b=b;
 		}
 
+	//the blitter may use the deemph entries directly, so fill them in too
+	ApplyDeemphasisComplete(palette_ntsc);
+
 	//can't call FCEU_ResetPalette(), it would be re-entrant
 	//see precondition for this function
 	WritePalette();
@@ -572,6 +590,10 @@ void WritePalette(void)
 	for(x=0;x<64;x++)
 		FCEUD_SetPalette(128+x,palo[x].r,palo[x].g,palo[x].b);
 	SetNESDeemph_OldHacky(lastd,1);
+#ifdef GEKKO
+	//all 8 emphasis variants, for blitting XBuf with XDBuf
+	FCEUD_SetEmphasisPalette((const uint8 *)palo);
+#endif
 	#ifdef _S9XLUA_H
 	FCEU_LuaUpdatePalette();
 	#endif
@@ -653,16 +675,17 @@ void FCEU_DrawNTSCControlBars(uint8 *XBuf)
 
 	if(controlselect==1)
 	{
-		DrawTextTrans(XBuf+128-12+180*256, 256, (uint8 *)"Hue", 0x85);
+		DrawTextTransLayer(XBuf, XBuf+128-12+180*256, 256, (uint8 *)"Hue", 0x85);
 		which=ntschue<<1;
 	}
 	else if(controlselect==2)
 	{
-		DrawTextTrans(XBuf+128-16+180*256, 256, (uint8 *)"Tint", 0x85);
+		DrawTextTransLayer(XBuf, XBuf+128-16+180*256, 256, (uint8 *)"Tint", 0x85);
 		which=ntsctint<<1;
 	}
 
 	XBaf=XBuf+200*256;
+	FCEU_OverlayMark(XBuf, 200-6, 13);
 	for(x=0;x<which;x+=2)
 	{
 		for(x2=6;x2>=-6;x2--)
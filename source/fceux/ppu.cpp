@@ -430,14 +430,18 @@ inline void FFCEUX_PPUWrite_Default(uint32 A, uint8 V) {
 	if (PPU_hook) PPU_hook(A);
 
 	if (tmp < 0x2000) {
-		if (PPUCHRRAM & (1 << (tmp >> 10)))
+		if (PPUCHRRAM & (1 << (tmp >> 10))) {
 			VPage[tmp >> 10][tmp] = V;
+			FCEUSS_MarkWrite(&VPage[tmp >> 10][tmp]);
+		}
 	} else if (tmp < 0x3F00) {
 		if (QTAIHack && (qtaintramreg & 1)) {
 			QTAINTRAM[((((tmp & 0xF00) >> 10) >> ((qtaintramreg >> 1)) & 1) << 10) | (tmp & 0x3FF)] = V;
 		} else {
-			if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10)))
+			if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10))) {
 				vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF] = V;
+				FCEUSS_MarkWrite(&vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF]); // may be mapped into CHR RAM
+			}
 		}
 	} else {
 		if (!(tmp & 3)) {
@@ -974,14 +978,18 @@ static DECLFW(B2007) {
 	} else {
 		PPUGenLatch = V;
 		if (tmp < 0x2000) {
-			if (PPUCHRRAM & (1 << (tmp >> 10)))
+			if (PPUCHRRAM & (1 << (tmp >> 10))) {
 				VPage[tmp >> 10][tmp] = V;
+				FCEUSS_MarkWrite(&VPage[tmp >> 10][tmp]);
+			}
 		} else if (tmp < 0x3F00) {
 			if (QTAIHack && (qtaintramreg & 1)) {
 				QTAINTRAM[((((tmp & 0xF00) >> 10) >> ((qtaintramreg >> 1)) & 1) << 10) | (tmp & 0x3FF)] = V;
 			} else {
-				if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10)))
+				if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10))) {
 					vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF] = V;
+					FCEUSS_MarkWrite(&vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF]); // may be mapped into CHR RAM
+				}
 			}
 		} else {
 			if (!(tmp & 3)) {
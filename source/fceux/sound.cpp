@@ -27,6 +27,7 @@
 #include "state.h"
 #include "wave.h"
 #include "debug.h"
+#include "driver.h"
 
 #include <cstdlib>
 #include <cstdio>
@@ -35,9 +36,11 @@
 static uint32 wlookup1[32];
 static uint32 wlookup2[203];
 
-int32 Wave[2048+512];
+/* A frame of output at FCEUI_SOUND_MAXRATE (3840 samples at 192000hz PAL, plus
+   the rate adjust) and what is left over from the last one. */
+int32 Wave[4096+512];
 int32 WaveHi[40000];
-int32 WaveFinal[2048+512];
+int32 WaveFinal[4096+512];
 
 EXPSOUND GameExpSound={0,0,0};
 
@@ -84,6 +87,19 @@ uint32 soundtsi=0;
 static int32 sqacc[2];
 /* LQ variables segment ends. */
 
+static int32 soundrateadjust=0;	/* Parts per million, see FCEUI_SetSoundRateAdjust(). */
+
+/* Band-limited mode: the output levels last passed to BlipAddDelta(). */
+static int32 sqlevel=0;
+static int32 tndlevel=0;
+/* Also the expansion sound level while mixing ExpDelta in HQ mode. */
+static int32 explevel=0;
+
+/* HQ mode: expansion sound level changes from FCEU_SoundDelta(), by
+   timestamp.  Mixed in and cleared by FlushEmulateSound(). */
+static int32 ExpDelta[40000];
+static int expdelta=0;
+
 /*static*/ int32 lengthcount[4];
 static const uint8 lengthtable[0x20]=
 {
@@ -145,6 +161,15 @@ static void (*DoSQ2)(void)=Dummyfunc;
 
 static uint32 ChannelBC[5];
 
+/* High quality renderers: while a channel's output stays at one level, it is
+   not added to WaveHi cycle by cycle but held from spanstart up to ChannelBC,
+   and only written out (FlushSpan()) when the level changes or the frame has
+   to be mixed.  soundactive is set once anything in WaveHi varies over the
+   frame; while it stays clear the frame is a single dc level. */
+static int32 spanlevel[5];
+static uint32 spanstart[5];
+static int soundactive=1;
+
 //savestate sync hack stuff
 int movieSyncHackOn=0,resetDMCacc=0,movieConvertOffset1,movieConvertOffset2;
 
@@ -543,6 +568,17 @@ static INLINE void DMCDMA(void)
  }
 }
 
+void FCEU_SoundDelta(uint32 ts, int32 delta)
+{
+ if(FSettings.soundq==3)
+  BlipAddDelta(ts,delta);
+ else
+ {
+  ExpDelta[ts]+=delta;
+  expdelta=1;
+ }
+}
+
 void FCEU_SoundCPUHook(int cycles)
 {
  fhcnt-=cycles*48;
@@ -582,13 +618,47 @@ void FCEU_SoundCPUHook(int cycles)
  }
 }
 
-void RDoPCM(void)
+static void FlushSpan(int x)
 {
- uint32 V; //mbg merge 7/17/06 made uint32
+ uint32 V;
+ int32 level=spanlevel[x];
+
+ if(level)
+  for(V=spanstart[x];V<ChannelBC[x];V++)
+   WaveHi[V]+=level;
+ spanstart[x]=ChannelBC[x];
+}
+
+/* Channel x outputs level from ChannelBC[x] up to SOUNDTS. */
+static void HoldLevel(int x, int32 level)
+{
+ if(SOUNDTS<ChannelBC[x])
+ {           /* The DMC fudge went back in time; the original renderer adds over it again. */
+  FlushSpan(x);
+  spanstart[x]=SOUNDTS;
+  soundactive=1;
+ }
+ else if(level!=spanlevel[x] && spanstart[x]<ChannelBC[x])
+ {
+  FlushSpan(x);
+  soundactive=1;
+ }
+ spanlevel[x]=level;
+ ChannelBC[x]=SOUNDTS;
+}
 
- for(V=ChannelBC[4];V<SOUNDTS;V++)
-  WaveHi[V]+=(((RawDALatch<<16)/256) * FSettings.PCMVolume)&(~0xFFFF); // TODO get rid of floating calculations to binary. set log volume scaling.
- ChannelBC[4]=SOUNDTS;
+/* Channel x is about to add varying output to WaveHi from ChannelBC[x] on. */
+static void ActiveSpan(int x)
+{
+ FlushSpan(x);
+ spanlevel[x]=0;
+ spanstart[x]=SOUNDTS;
+ soundactive=1;
+}
+
+void RDoPCM(void)
+{
+ HoldLevel(4,(((RawDALatch<<16)/256) * FSettings.PCMVolume)&(~0xFFFF)); // TODO get rid of floating calculations to binary. set log volume scaling.
 }
 
 /* This has the correct phase.  Don't mess with it. */
@@ -621,8 +691,26 @@ static INLINE void RDoSQ(int x)		//Int x decides if this is Square Wave 1 or 2
 
    amp<<=24;
 
+   if(!amp)
+   {           /* Silent, but the duty cycle keeps running. */
+    V=SOUNDTS-ChannelBC[x];
+    rc=wlcount[x];
+    if(rc>0 && V>=rc)
+    {
+     cf=(curfreq[x]+1)*2;
+     V-=rc;
+     RectDutyCount[x]=(RectDutyCount[x]+1+V/cf)&7;
+     rc=cf-V%cf;
+    }
+    else
+     rc-=V;
+    wlcount[x]=rc;
+    goto endit;
+   }
+
    rthresh=RectDuties[(PSG[(x<<2)]&0xC0)>>6];
 
+   ActiveSpan(x);
    D=&WaveHi[ChannelBC[x]];
    V=SOUNDTS-ChannelBC[x];
 
@@ -646,9 +734,11 @@ static INLINE void RDoSQ(int x)		//Int x decides if this is Square Wave 1 or 2
 
    RectDutyCount[x]=currdc;
    wlcount[x]=rc;
+   ChannelBC[x]=SOUNDTS;
+   return;
 
    endit:
-   ChannelBC[x]=SOUNDTS;
+   HoldLevel(x,0);
 }
 
 static void RDoSQ1(void)
@@ -778,11 +868,11 @@ static void RDoTriangle(void)
    *start += (tcout/256*FSettings.TriangleVolume)&(~0xFFFF);  // TODO OPTIMIZE ME NOW DAMMIT!
    start++;
   }*/
-  int32 cout = (tcout/256*FSettings.TriangleVolume)&(~0xFFFF);
-  for(V=ChannelBC[2];V<SOUNDTS;V++)
-   WaveHi[V]+=cout;
+  HoldLevel(2,(tcout/256*FSettings.TriangleVolume)&(~0xFFFF));
+  return;
  }
- else
+
+ ActiveSpan(2);
   for(V=ChannelBC[2];V<SOUNDTS;V++)
   {
     //Modify volume based on channel volume modifiers
@@ -945,6 +1035,164 @@ static void RDoTriangleNoisePCMLQ(void)
 }
 
 
+/* Band-limited versions.  Both squares, and the triangle, noise and PCM
+   channels, are mixed non-linearly, so each group is run together from one
+   change to the next, and only the changes of the mixed level are output.
+   Same results as RDoSQ(), RDoTriangle(), RDoNoise() and RDoPCM(), except
+   that the triangle is halted at ultrasonic frequencies, as in low quality
+   mode.
+*/
+static void RDoSQBlip(void)
+{
+   int32 start,end,t,next;
+   int32 amp[2], ampx;
+   int32 rthresh[2];
+   int32 cf[2];
+   int32 out;
+   int x;
+
+   start=ChannelBC[0];
+   end=SOUNDTS;
+   if(end<=start) return;
+   ChannelBC[0]=end;
+
+   for(x=0;x<2;x++)
+   {
+    amp[x]=rthresh[x]=cf[x]=0;	/* cf 0: not running */
+
+    if(curfreq[x]<8 || curfreq[x]>0x7ff)
+     continue;
+    if(!CheckFreq(curfreq[x],PSG[(x<<2)|0x1]))
+     continue;
+    if(!lengthcount[x])
+     continue;
+
+    if(EnvUnits[x].Mode&0x1)
+     amp[x]=EnvUnits[x].Speed;
+    else
+     amp[x]=EnvUnits[x].decvolume;
+
+    ampx = x ? FSettings.Square2Volume : FSettings.Square1Volume;
+    if (ampx != 256) amp[x] = (amp[x] * ampx) / 256;
+
+    rthresh[x]=RectDuties[(PSG[(x<<2)]&0xC0)>>6];
+    cf[x]=(curfreq[x]+1)*2;
+    if(wlcount[x]<=0) wlcount[x]=1;
+   }
+
+   t=start;
+   for(;;)
+   {
+    out=wlookup1[(RectDutyCount[0]<rthresh[0]?amp[0]:0)+(RectDutyCount[1]<rthresh[1]?amp[1]:0)];
+    if(out!=sqlevel)
+    {
+     BlipAddDelta(t,out-sqlevel);
+     sqlevel=out;
+    }
+
+    next=end;
+    for(x=0;x<2;x++)
+     if(cf[x] && t+wlcount[x]<next)
+      next=t+wlcount[x];
+
+    for(x=0;x<2;x++)
+     if(cf[x])
+     {
+      wlcount[x]-=next-t;
+      if(!wlcount[x])
+      {
+       wlcount[x]=cf[x];
+       RectDutyCount[x]=(RectDutyCount[x]+1)&7;
+      }
+     }
+
+    t=next;
+    if(t>=end) break;
+   }
+}
+
+static void RDoTriangleNoisePCMBlip(void)
+{
+   int32 start,end,t,next;
+   int32 trifreq,noisefreq;
+   int32 noiseamp,pcm,tcout;
+   int32 out;
+   int nshift;
+
+   start=ChannelBC[2];
+   end=SOUNDTS;
+   if(end<=start) return;
+   ChannelBC[2]=end;
+
+   trifreq=(PSG[0xa]|((PSG[0xb]&7)<<8))+1;
+   if(!lengthcount[2] || !TriCount || trifreq<=4)
+    trifreq=0;
+
+   if(EnvUnits[2].Mode&0x1)
+    noiseamp=EnvUnits[2].Speed;
+   else
+    noiseamp=EnvUnits[2].decvolume;
+   if (FSettings.NoiseVolume != 256) noiseamp = (noiseamp * FSettings.NoiseVolume) / 256;
+   noiseamp<<=1;
+   if(!lengthcount[3])
+    noiseamp=0;
+
+   if(PAL)
+    noisefreq=NoiseFreqTablePAL[PSG[0xE]&0xF];
+   else
+    noisefreq=NoiseFreqTableNTSC[PSG[0xE]&0xF];
+
+   if(PSG[0xE]&0x80)
+    nshift=8;
+   else
+    nshift=13;
+
+   pcm=(RawDALatch*FSettings.PCMVolume)>>8;
+
+   if(wlcount[2]<=0) wlcount[2]=1;
+   if(wlcount[3]<=0) wlcount[3]=1;
+
+   t=start;
+   for(;;)
+   {
+    tcout=(tristep&0xF);
+    if(!(tristep&0x10)) tcout^=0xF;
+    out=wlookup2[((tcout*3*FSettings.TriangleVolume)>>8)+((nreg&0x4000)?0:noiseamp)+pcm];
+    if(out!=tndlevel)
+    {
+     BlipAddDelta(t,out-tndlevel);
+     tndlevel=out;
+    }
+
+    next=t+wlcount[3];
+    if(trifreq && t+wlcount[2]<next)
+     next=t+wlcount[2];
+    if(next>end)
+     next=end;
+
+    if(trifreq)
+    {
+     wlcount[2]-=next-t;
+     if(!wlcount[2])
+     {
+      wlcount[2]=trifreq;
+      tristep++;
+     }
+    }
+
+    wlcount[3]-=next-t;
+    if(!wlcount[3])
+    {
+     wlcount[3]=noisefreq;
+     nreg=(nreg<<1)+(((nreg>>nshift)^(nreg>>14))&1);
+     nreg&=0x7fff;
+    }
+
+    t=next;
+    if(t>=end) break;
+   }
+}
+
 static void RDoNoise(void)
 {
  uint32 V; //mbg merge 7/17/06 made uint32
@@ -971,6 +1219,27 @@ static void RDoNoise(void)
   outo=amptab[0]=0;
  }
 
+ if(!amptab[0])
+ {           /* Silent, but the shift register keeps running. */
+  int nshift=(PSG[0xE]&0x80)?8:13;
+
+  V=SOUNDTS>ChannelBC[3]?SOUNDTS-ChannelBC[3]:0;
+  while(wlcount[3]>0 && V>=(uint32)wlcount[3])
+  {
+   V-=wlcount[3];
+   if(PAL)
+     wlcount[3]=NoiseFreqTablePAL[PSG[0xE]&0xF];
+   else
+     wlcount[3]=NoiseFreqTableNTSC[PSG[0xE]&0xF];
+   nreg=(nreg<<1)+(((nreg>>nshift)^(nreg>>14))&1);
+   nreg&=0x7fff;
+  }
+  wlcount[3]-=V;
+  HoldLevel(3,0);
+  return;
+ }
+
+ ActiveSpan(3);
  if(PSG[0xE]&0x80)  // "short" noise
   for(V=ChannelBC[3];V<SOUNDTS;V++)
   {
@@ -1054,26 +1323,104 @@ int FlushEmulateSound(void)
   DoNoise();
   DoPCM();
 
-  if(FSettings.soundq>=1)
+  if(FSettings.soundq==3)
   {
-   int32 *tmpo=&WaveHi[soundtsoffs];
+   if(GameExpSound.DeltaFill) GameExpSound.DeltaFill();
+   else if(GameExpSound.HiFill)
+   {
+    GameExpSound.HiFill();
 
-   if(GameExpSound.HiFill) GameExpSound.HiFill();
+    /* Expansion sound is mixed linearly, in the low 16 bits. */
+    for(x=0;x<(int)SOUNDTS;x++)
+     if(WaveHi[x]!=explevel)
+     {
+      BlipAddDelta(x,WaveHi[x]-explevel);
+      explevel=WaveHi[x];
+     }
+    memset(WaveHi,0,SOUNDTS*sizeof(uint32));
+   }
 
-   for(x=soundtimestamp;x;x--)
+   end=BlipFilterSound(WaveFinal,SOUNDTS);
+   left=0;
+
+   if(GameExpSound.HiSync) GameExpSound.HiSync(0);
+   for(x=0;x<5;x++)
+    ChannelBC[x]=0;
+  }
+  else if(FSettings.soundq>=1)
+  {
+   uint32 b=0;
+   int32 dc;
+
+   if(GameExpSound.DeltaFill)
+    GameExpSound.DeltaFill();
+   else if(GameExpSound.HiFill)
+   {
+    GameExpSound.HiFill();
+    soundactive=1;
+   }
+   if(expdelta)
+    soundactive=1;
+
+   for(x=0;x<5;x++)
+    b+=spanlevel[x];
+   dc=(b&65535)+wlookup2[(b>>16)&255]+wlookup1[b>>24]+explevel;
+
+   /* The filter also reads the leftover of the previous frame. */
+   for(x=0;!soundactive && x<(int)soundtsoffs;x++)
+    if(WaveHi[x]!=dc)
+     soundactive=1;
+
+   if(!soundactive)
    {
-    uint32 b=*tmpo;
-    *tmpo=(b&65535)+wlookup2[(b>>16)&255]+wlookup1[b>>24];
-    tmpo++;
+    /* Every channel held one level all frame: skip the mix and the FIR. */
+    end=NeoFilterDC(dc,WaveFinal,SOUNDTS,&left);
+
+    for(x=0;x<left;x++)
+     WaveHi[x]=dc;
+    if(left<(int32)soundtsoffs)
+     memset(WaveHi+left,0,(soundtsoffs-left)*sizeof(uint32));
    }
-   end=NeoFilterSound(WaveHi,WaveFinal,SOUNDTS,&left);
+   else
+   {
+    int32 *tmpo=&WaveHi[soundtsoffs];
+
+    for(x=0;x<5;x++)
+     FlushSpan(x);
+
+    if(expdelta)
+    {
+     int32 *delta=&ExpDelta[soundtsoffs];
+
+     for(x=soundtimestamp;x;x--)
+     {
+      explevel+=*delta;
+      *delta++=0;
+      b=*tmpo;
+      *tmpo=(b&65535)+wlookup2[(b>>16)&255]+wlookup1[b>>24]+explevel;
+      tmpo++;
+     }
+     expdelta=0;
+    }
+    else
+     for(x=soundtimestamp;x;x--)
+     {
+      b=*tmpo;
+      *tmpo=(b&65535)+wlookup2[(b>>16)&255]+wlookup1[b>>24]+explevel;
+      tmpo++;
+     }
+    end=NeoFilterSound(WaveHi,WaveFinal,SOUNDTS,&left);
 
-   memmove(WaveHi,WaveHi+SOUNDTS-left,left*sizeof(uint32));
-   memset(WaveHi+left,0,sizeof(WaveHi)-left*sizeof(uint32));
+    /* Nothing is rendered past SOUNDTS, so only the frame needs clearing. */
+    memmove(WaveHi,WaveHi+SOUNDTS-left,left*sizeof(uint32));
+    if(SOUNDTS>(uint32)left)
+     memset(WaveHi+left,0,(SOUNDTS-left)*sizeof(uint32));
+   }
 
    if(GameExpSound.HiSync) GameExpSound.HiSync(left);
    for(x=0;x<5;x++)
-    ChannelBC[x]=left;
+    ChannelBC[x]=spanstart[x]=left;
+   soundactive=0;
   }
   else
   {
@@ -1209,11 +1556,25 @@ void FCEUSND_Power(void)
 
         for(x=0;x<5;x++)
          ChannelBC[x]=0;
+        memset(spanlevel,0,sizeof(spanlevel));
+        memset(spanstart,0,sizeof(spanstart));
+        explevel=0;
+        memset(ExpDelta,0,sizeof(ExpDelta));
+        expdelta=0;
+        soundactive=1;
         soundtsoffs=0;
         LoadDMCPeriod(DMCFormat&0xF);
 }
 
 
+static void SetSoundRates(void)
+{
+  double adj=1+(double)soundrateadjust/1000000;
+
+  nesincsize=(int64)(((int64)1<<17)*(double)(PAL?PAL_CPU:NTSC_CPU)*adj/(FSettings.SndRate * 16));
+  soundtsinc=(uint32)((uint64)(PAL?(long double)PAL_CPU*65536:(long double)NTSC_CPU*65536)*adj/(FSettings.SndRate * 16));
+}
+
 void SetSoundVariables(void)
 {
   int x;
@@ -1235,7 +1596,12 @@ void SetSoundVariables(void)
     wlookup2[x]=(double)16*16*16*4*163.67/((double)24329/(double)x+100);
     if(!FSettings.soundq) wlookup2[x]>>=4;
    }
-   if(FSettings.soundq>=1)
+   if(FSettings.soundq==3)
+   {
+    DoSQ1=DoSQ2=RDoSQBlip;
+    DoTriangle=DoNoise=DoPCM=RDoTriangleNoisePCMBlip;
+   }
+   else if(FSettings.soundq>=1)
    {
     DoNoise=RDoNoise;
     DoTriangle=RDoTriangle;
@@ -1264,17 +1630,29 @@ void SetSoundVariables(void)
   if(GameExpSound.RChange)
    GameExpSound.RChange();
 
-  nesincsize=(int64)(((int64)1<<17)*(double)(PAL?PAL_CPU:NTSC_CPU)/(FSettings.SndRate * 16));
+  SetSoundRates();
   memset(sqacc,0,sizeof(sqacc));
   memset(ChannelBC,0,sizeof(ChannelBC));
+  memset(spanlevel,0,sizeof(spanlevel));
+  memset(spanstart,0,sizeof(spanstart));
+  soundactive=1;
 
-  LoadDMCPeriod(DMCFormat&0xF);  // For changing from PAL to NTSC
+  /* MakeFilters() cleared the band-limited buffer. */
+  sqlevel=tndlevel=explevel=0;
+  memset(ExpDelta,0,sizeof(ExpDelta));
+  expdelta=0;
+  if(FSettings.soundq==3)
+   memset(WaveHi,0,sizeof(WaveHi));
 
-  soundtsinc=(uint32)((uint64)(PAL?(long double)PAL_CPU*65536:(long double)NTSC_CPU*65536)/(FSettings.SndRate * 16));
+  LoadDMCPeriod(DMCFormat&0xF);  // For changing from PAL to NTSC
 }
 
 void FCEUI_Sound(int Rate)
 {
+	if(Rate && Rate<FCEUI_SOUND_MINRATE)
+		Rate=FCEUI_SOUND_MINRATE;
+	else if(Rate>FCEUI_SOUND_MAXRATE)
+		Rate=FCEUI_SOUND_MAXRATE;
 	FSettings.SndRate=Rate;
 	SetSoundVariables();
 }
@@ -1290,6 +1668,21 @@ void FCEUI_SetSoundQuality(int quality)
 	SetSoundVariables();
 }
 
+//Stretches the sound output by ppm parts per million (positive: fewer samples
+//per frame), for keeping the driver's buffer level steady.  Call between frames.
+void FCEUI_SetSoundRateAdjust(int32 ppm)
+{
+	soundrateadjust=ppm;
+	FilterRateAdjust(ppm);
+	if(FSettings.SndRate)
+		SetSoundRates();
+}
+
+int32 FCEUI_GetSoundRateAdjust(void)
+{
+	return soundrateadjust;
+}
+
 void FCEUI_SetSoundVolume(uint32 volume)
 {
 	FSettings.SoundVolume=volume;
@@ -34,6 +34,13 @@ typedef struct {
 	   void (*HiFill)(void);
 	   void (*HiSync)(int32 ts);
 
+	   /* DeltaFill replaces HiFill in the high-quality and band-limited
+	      modes.  It passes the changes of the output level, with their
+	      timestamps, to FCEU_SoundDelta() instead of adding the level
+	      to WaveHi every cycle.
+	   */
+	   void (*DeltaFill)(void);
+
 	   void (*RChange)(void);
 	   void (*Kill)(void);
 } EXPSOUND;
@@ -46,8 +53,8 @@ void SetSoundVariables(void);
 
 int GetSoundBuffer(int32 **W);
 int FlushEmulateSound(void);
-extern int32 Wave[2048+512];
-extern int32 WaveFinal[2048+512];
+extern int32 Wave[4096+512];
+extern int32 WaveFinal[4096+512];
 extern int32 WaveHi[];
 extern uint32 soundtsinc;
 
@@ -70,6 +77,7 @@ void FCEUSND_SaveState(void);
 void FCEUSND_LoadState(int version);
 
 void FCEU_SoundCPUHook(int);
+void FCEU_SoundDelta(uint32 ts, int32 delta);
 void Write_IRQFM (uint32 A, uint8 V); //mbg merge 7/17/06 brought over from latest mmbuild
 
 void LogDPCM(int romaddress, int dpcmsize);
@@ -28,8 +28,10 @@
 #include "utils/endian.h"
 #include "utils/memory.h"
 #include "utils/xstring.h"
+#include "utils/lz.h"
 #include "file.h"
 #include "fds.h"
+#include "cart.h"
 #include "state.h"
 #include "movie.h"
 #include "ppu.h"
@@ -87,6 +89,8 @@ bool compressSavestates = true;  //By default FCEUX compresses savestates when a
 EMUFILE_MEMORY memory_savestate;
 // temporary buffer for compressed data of a savestate
 std::vector<uint8> compressed_buf;
+// hash table of the LZ compressor
+static uint8 lz_work[LZ_WORKSIZE];
 
 #define SFMDATA_SIZE (128)
 static SFORMAT SFMDATA[SFMDATA_SIZE];
@@ -127,93 +131,303 @@ SFORMAT SFCPUC[]={
 
 void foo(uint8* test) { (void)test; }
 
-static int SubWrite(EMUFILE* os, SFORMAT *sf)
+//Field layouts. Each SFORMAT list that is saved or loaded gets its fields
+//flattened, following ~0 links, in the order they are written, with the
+//size of the chunk they make. For loading there is also a hash of the
+//fields by tag and where each field of the layout is loaded to, so a save
+//with the same layout is read without any lookups.
+//The indexes are rebuilt after the extra state of the game changes.
+struct SFINDEX
 {
-	uint32 acc=0;
+	SFORMAT *root;
+	bool built;
+	uint32 size;	//bytes of the chunk, 0 if nothing is written
+	uint32 mask;
+	std::vector<SFORMAT*> table;	//first field with each tag, open addressing
+	std::vector<SFORMAT*> layout;
+	std::vector<SFORMAT*> target;	//where layout[i] is loaded to, 0 = skipped
+};
 
-	while(sf->v)
+#define SFINDEX_MAX 16
+static SFINDEX sfindex[SFINDEX_MAX];
+static int sfindexcount=0;
+
+static INLINE uint32 SFTag(const char *desc)
+{
+	uint32 tag;
+	memcpy(&tag,desc,4);
+	return tag;
+}
+
+static INLINE uint32 SFHash(uint32 tag)
+{
+	return (tag*2654435761U)>>16;
+}
+
+//The same result as searching the list: the first field with the tag, or 0
+//if its size does not match.
+static SFORMAT *FindS(SFINDEX *index, uint32 tsize, const char *desc)
+{
+	uint32 tag=SFTag(desc);
+	uint32 slot=SFHash(tag)&index->mask;
+	SFORMAT *sf;
+
+	while((sf=index->table[slot]))
 	{
-		if(sf->s==~0)		//Link to another struct
+		if(SFTag(sf->desc)==tag)
 		{
-			uint32 tmp;
-
-			if(!(tmp=SubWrite(os,(SFORMAT *)sf->v)))
+			if(tsize!=(sf->s&(~FCEUSTATE_FLAGS)))
 				return(0);
-			acc+=tmp;
-			sf++;
-			continue;
+			return(sf);
 		}
+		slot=(slot+1)&index->mask;
+	}
+	return(0);
+}
 
-		acc+=8;			//Description + size
-		acc+=sf->s&(~FCEUSTATE_FLAGS);
+//Returns false if the list or one it links to is empty, in which case
+//nothing is written for the chunk.
+static bool FlattenS(SFORMAT *sf, std::vector<SFORMAT*> &out)
+{
+	size_t start=out.size();
+	bool full=true;
 
-		if(os)			//Are we writing or calculating the size of this block?
-		{
-			os->fwrite(sf->desc,4);
-			write32le(sf->s&(~FCEUSTATE_FLAGS),os);
+	while(sf->v)
+	{
+		if(sf->s==~0)		// Link to another SFORMAT structure.
+			full&=FlattenS((SFORMAT *)sf->v,out);
+		else
+			out.push_back(sf);
+		sf++;
+	}
+	return full && out.size()>start;
+}
 
-#ifndef LSB_FIRST
-			if(sf->s&RLSB)
-				FlipByteOrder((uint8*)sf->v,sf->s&(~FCEUSTATE_FLAGS));
-#endif
+static void BuildIndex(SFINDEX *index)
+{
+	uint32 n=16;
+	size_t x;
 
-			if(sf->s&FCEUSTATE_INDIRECT)
-				os->fwrite(*(char **)sf->v,sf->s&(~FCEUSTATE_FLAGS));
-			else
-				os->fwrite((char*)sf->v,sf->s&(~FCEUSTATE_FLAGS));
+	index->layout.clear();
+	index->size=0;
+	if(FlattenS(index->root,index->layout))
+	{
+		for(x=0;x<index->layout.size();x++)
+			index->size+=8+(index->layout[x]->s&(~FCEUSTATE_FLAGS));	//Description + size + data
+	}
 
-			//Now restore the original byte order.
-#ifndef LSB_FIRST
-			if(sf->s&RLSB)
-				FlipByteOrder((uint8*)sf->v,sf->s&(~FCEUSTATE_FLAGS));
-#endif
-		}
-		sf++;
+	while(n<index->layout.size()*2)
+		n<<=1;
+	index->mask=n-1;
+	index->table.assign(n,(SFORMAT*)0);
+
+	for(x=0;x<index->layout.size();x++)
+	{
+		SFORMAT *sf=index->layout[x];
+		uint32 tag=SFTag(sf->desc);
+		uint32 slot=SFHash(tag)&index->mask;
+
+		while(index->table[slot] && SFTag(index->table[slot]->desc)!=tag)
+			slot=(slot+1)&index->mask;
+		if(!index->table[slot])
+			index->table[slot]=sf;
 	}
 
-	return(acc);
+	index->target.resize(index->layout.size());
+	for(x=0;x<index->layout.size();x++)
+		index->target[x]=FindS(index,index->layout[x]->s&(~FCEUSTATE_FLAGS),index->layout[x]->desc);
+
+	index->built=true;
 }
 
-static int WriteStateChunk(EMUFILE* os, int type, SFORMAT *sf)
+static SFINDEX *GetIndex(SFORMAT *sf)
 {
-	os->fputc(type);
-	int bsize = SubWrite((EMUFILE*)0,sf);
-	write32le(bsize,os);
+	SFINDEX *index=0;
+	int x;
+
+	for(x=0;x<sfindexcount;x++)
+		if(sfindex[x].root==sf)
+			index=&sfindex[x];
 
-	if(!SubWrite(os,sf))
+	if(!index)
 	{
-		return 5;
+		if(sfindexcount<SFINDEX_MAX)
+			sfindexcount++;
+		index=&sfindex[sfindexcount-1];
+		index->root=sf;
+		index->built=false;
+	}
+	if(!index->built)
+		BuildIndex(index);
+	return(index);
+}
+
+SFTRACKED FCEUSS_Tracked[FCEUSTATE_MAXTRACKED];
+int FCEUSS_TrackedCount=0;
+uint32 FCEUSS_NextCapture=1;
+
+static std::vector<uint32> trackedpages[FCEUSTATE_MAXTRACKED];
+static bool trackwrites=false;
+static bool trackingbuilt=false;
+static uint32 firstcapture=1;	//captures before this one are not used
+
+void FCEUSS_InvalidateCaptures(void)
+{
+	FCEUSS_TrackedCount=0;
+	trackingbuilt=false;
+	firstcapture=FCEUSS_NextCapture;
+}
+
+void FCEUSS_TrackWrites(bool enable)
+{
+	trackwrites=enable;
+	FCEUSS_InvalidateCaptures();
+}
+
+static void TrackMemory(uint8 *p, uint32 size)
+{
+	int x;
+
+	if(!p || !size || FCEUSS_TrackedCount==FCEUSTATE_MAXTRACKED)
+		return;
+
+	for(x=0;x<FCEUSS_TrackedCount;x++)
+		if(p<FCEUSS_Tracked[x].base+FCEUSS_Tracked[x].size && FCEUSS_Tracked[x].base<p+size)
+			return;	//already tracked, as a chip of both kinds
+
+	trackedpages[x].assign((size+(1<<FCEUSTATE_PAGESHIFT)-1)>>FCEUSTATE_PAGESHIFT,FCEUSS_NextCapture);
+	FCEUSS_Tracked[x].base=p;
+	FCEUSS_Tracked[x].size=size;
+	FCEUSS_Tracked[x].pages=&trackedpages[x][0];
+	FCEUSS_TrackedCount++;
+}
+
+static void BuildTracking(void)
+{
+	bool cartwram=true;
+	int x;
+
+	FCEUSS_InvalidateCaptures();
+	trackingbuilt=true;
+
+	//the NSF player clears RAM itself
+	if(!GameInfo || GameInfo->type==GIT_NSF)
+		return;
+
+	TrackMemory(RAM,0x800);
+
+	//boards with their own WRAM handlers may write it from anywhere
+	for(x=0x6000;x<0x8000;x++)
+		if(BWrite[x]!=CartBW)
+			cartwram=false;
+
+	for(x=0;x<32;x++)
+	{
+		if(cartwram && PRGram[x])
+			TrackMemory(PRGptr[x],PRGsize[x]);
+		if(CHRram[x])
+			TrackMemory(CHRptr[x],CHRsize[x]);
 	}
-	return (bsize+5);
 }
 
-static SFORMAT *CheckS(SFORMAT *sf, uint32 tsize, char *desc)
+//Copies the pages of a field in tracked memory that were written after
+//capture since. Returns false if the field is not tracked.
+static bool CopyWritten(uint8 *dst, const uint8 *v, uint32 size, uint32 since)
 {
-	while(sf->v)
+	for(int x=0;x<FCEUSS_TrackedCount;x++)
 	{
-		if(sf->s==~0)		// Link to another SFORMAT structure.
-		{
-			SFORMAT *tmp;
-			if((tmp= CheckS((SFORMAT *)sf->v, tsize, desc) ))
-				return(tmp);
-			sf++;
+		SFTRACKED *t=&FCEUSS_Tracked[x];
+		size_t offset=v-t->base;
+
+		if(offset>=t->size || size>t->size-offset)
 			continue;
-		}
-		if(!memcmp(desc,sf->desc,4))
+
+		for(uint32 pos=0;pos<size;)
 		{
-			if(tsize!=(sf->s&(~FCEUSTATE_FLAGS)))
-				return(0);
-			return(sf);
+			uint32 page=(offset+pos)>>FCEUSTATE_PAGESHIFT;
+			uint32 n=((page+1)<<FCEUSTATE_PAGESHIFT)-(offset+pos);
+
+			if(n>size-pos)
+				n=size-pos;
+			if(t->pages[page]>since)
+				memcpy(dst+pos,v+pos,n);
+			pos+=n;
 		}
-		sf++;
+		return true;
 	}
-	return(0);
+	return false;
+}
+
+static void InvalidateIndexes(void)
+{
+	for(int x=0;x<sfindexcount;x++)
+		sfindex[x].built=false;
+	FCEUSS_InvalidateCaptures();
+}
+
+static int WriteStateChunk(EMUFILE* os, int type, SFORMAT *sf)
+{
+	SFINDEX *index=GetIndex(sf);
+
+	os->fputc(type);
+	write32le(index->size,os);
+
+	if(!index->size)
+		return 5;
+
+	for(size_t x=0;x<index->layout.size();x++)
+	{
+		SFORMAT *f=index->layout[x];
+		uint32 size=f->s&(~FCEUSTATE_FLAGS);
+		uint8 *v=(f->s&FCEUSTATE_INDIRECT)?*(uint8 **)f->v:(uint8 *)f->v;
+
+		os->fwrite(f->desc,4);
+		write32le(size,os);
+
+		//RLSB fields too are written as they are in memory. FlipByteOrder
+		//never actually swapped them, so that is what existing states hold.
+		os->fwrite((char*)v,size);
+	}
+	return (index->size+5);
+}
+
+//WriteStateChunk straight into memory, which must hold the chunk. With since,
+//the chunk of that capture is already there and only written pages of tracked
+//fields are copied.
+static uint8 *CopyStateChunk(uint8 *dst, int type, SFORMAT *sf, uint32 since=0)
+{
+	SFINDEX *index=GetIndex(sf);
+
+	*dst++=type;
+	FCEU_en32lsb(dst,index->size);
+	dst+=4;
+
+	if(!index->size)
+		return dst;
+
+	for(size_t x=0;x<index->layout.size();x++)
+	{
+		SFORMAT *f=index->layout[x];
+		uint32 size=f->s&(~FCEUSTATE_FLAGS);
+		uint8 *v=(f->s&FCEUSTATE_INDIRECT)?*(uint8 **)f->v:(uint8 *)f->v;
+
+		memcpy(dst,f->desc,4);
+		FCEU_en32lsb(dst+4,size);
+		dst+=8;
+
+		if(!since || !CopyWritten(dst,v,size,since))
+			memcpy(dst,v,size);
+		dst+=size;
+	}
+	return dst;
 }
 
 static bool ReadStateChunk(EMUFILE* is, SFORMAT *sf, int size)
 {
+	SFINDEX *index=GetIndex(sf);
 	SFORMAT *tmp;
 	int temp = is->ftell();
+	uint32 field = 0;	//position in the layout while the save follows it
 
 	while(is->ftell()<temp+size)
 	{
@@ -224,17 +438,19 @@ static bool ReadStateChunk(EMUFILE* is, SFORMAT *sf, int size)
 
 		read32le(&tsize,is);
 
-		if((tmp=CheckS(sf,tsize,toa)))
+		if(field<index->layout.size() && !memcmp(toa,index->layout[field]->desc,4) && tsize==(index->layout[field]->s&(~FCEUSTATE_FLAGS)))
+			tmp=index->target[field++];
+		else
 		{
-			if(tmp->s&FCEUSTATE_INDIRECT)
-				is->fread(*(char **)tmp->v,tmp->s&(~FCEUSTATE_FLAGS));
-			else
-				is->fread((char *)tmp->v,tmp->s&(~FCEUSTATE_FLAGS));
+			field=~0;
+			tmp=FindS(index,tsize,toa);
+		}
 
-#ifndef LSB_FIRST
-			if(tmp->s&RLSB)
-				FlipByteOrder((uint8*)tmp->v,tmp->s&(~FCEUSTATE_FLAGS));
-#endif
+		if(tmp)
+		{
+			uint8 *v=(tmp->s&FCEUSTATE_INDIRECT)?*(uint8 **)tmp->v:(uint8 *)tmp->v;
+
+			is->fread((char *)v,tsize); //RLSB fields are stored as they are in memory
 		}
 		else
 			is->fseek(tsize,SEEK_CUR);
@@ -304,19 +520,18 @@ static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 			}
 			break;
 		case 8:
-			// load back buffer
+			// load back buffer (XBuf holds the frame without overlays)
 			{
-				extern uint8 *XBackBuf;
 				//ignore 8 garbage bytes, whose idea was it to write these or even have them there in the first place
 				if(size == 256*256+8)
 				{
-					if(is->fread((char*)XBackBuf,256*256) != 256*256)
+					if(is->fread((char*)XBuf,256*256) != 256*256)
 						ret = false;
 					is->fseek(8,SEEK_CUR);
 				}
 				else
 				{
-					if(is->fread((char*)XBackBuf,size) != size)
+					if(is->fread((char*)XBuf,size) != size)
 						ret = false;
 				}
 
@@ -375,7 +590,7 @@ int CurrentState=0;
 extern int geniestage;
 
 
-bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
+bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel, bool saveBackBuffer)
 {
 	// reinit memory_savestate
 	// memory_savestate is global variable which already has its vector of bytes, so no need to allocate memory every time we use save/loadstate
@@ -413,12 +628,12 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 		}
 	}
 	// save back buffer
+	if(saveBackBuffer)
 	{
-		extern uint8 *XBackBuf;
 		uint32 size = 256 * 256;
 		os->fputc(8);
 		write32le(size, os);
-		os->fwrite((char*)XBackBuf,size);
+		os->fwrite((char*)XBuf,size);
 		totalsize += 5 + size;
 	}
 
@@ -439,7 +654,15 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 	int error = Z_OK;
 	uint8* cbuf = (uint8*)memory_savestate.buf();
 	uLongf comprlen = -1;
-	if(compressionLevel != Z_NO_COMPRESSION && (compressSavestates || FCEUMOV_Mode(MOVIEMODE_TASEDITOR)))
+	uint32 version = FCEU_VERSION_NUMERIC;
+	if(compressionLevel == FCEU_LZ_COMPRESSION && (compressSavestates || FCEUMOV_Mode(MOVIEMODE_TASEDITOR)))
+	{
+		if (compressed_buf.size() < LZ_BOUND(len)) compressed_buf.resize(LZ_BOUND(len));
+		cbuf = &compressed_buf[0];
+		comprlen = LZCompress((uint8*)memory_savestate.buf(), len, cbuf, lz_work);
+		version |= FCEUSTATE_HEADER_LZ;
+	}
+	else if(compressionLevel != Z_NO_COMPRESSION && compressionLevel != FCEU_LZ_COMPRESSION && (compressSavestates || FCEUMOV_Mode(MOVIEMODE_TASEDITOR)))
 	{
 		// worst case compression: zlib says "0.1% larger than sourceLen plus 12 bytes"
 		comprlen = (len>>9)+12 + len;
@@ -452,7 +675,7 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 	//dump the header
 	uint8 header[16]="FCSX";
 	FCEU_en32lsb(header+4, totalsize);
-	FCEU_en32lsb(header+8, FCEU_VERSION_NUMERIC);
+	FCEU_en32lsb(header+8, version);
 	FCEU_en32lsb(header+12, comprlen);
 
 	//dump it to the destination file
@@ -463,6 +686,156 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 }
 
 
+static bool ArenaSupported(void)
+{
+	//the movie state is only written through an EMUFILE
+	return !FCEUMOV_Mode(MOVIEMODE_PLAY|MOVIEMODE_RECORD|MOVIEMODE_FINISHED);
+}
+
+uint32 FCEUSS_StateSize(bool saveBackBuffer)
+{
+	if(!ArenaSupported())
+		return 0;
+
+	uint32 size=16;
+	size+=5+GetIndex(SFCPU)->size;
+	size+=5+GetIndex(SFCPUC)->size;
+	size+=5+GetIndex(FCEUPPU_STATEINFO)->size;
+	size+=5+GetIndex(FCEU_NEWPPU_STATEINFO)->size;
+	size+=5+GetIndex(FCEUCTRL_STATEINFO)->size;
+	size+=5+GetIndex(FCEUSND_STATEINFO)->size;
+	if(saveBackBuffer)
+		size+=5+256*256;
+	size+=5+GetIndex(SFMDATA)->size;
+	return size;
+}
+
+//The same state as FCEUSS_SaveMS with Z_NO_COMPRESSION, copied field by field
+//into arena, without an EMUFILE or any allocation once the game's layouts
+//are built. While a movie is active the state is taken with FCEUSS_SaveMS,
+//and never incrementally.
+uint32 FCEUSS_SaveArena(uint8 *arena, uint32 arenasize, bool saveBackBuffer, uint32 *capture)
+{
+	uint32 since=0;
+
+	if(capture && (!trackwrites || !ArenaSupported()))
+		*capture=0;
+
+	if(!ArenaSupported())
+	{
+		EMUFILE_MEMORY ms;
+		if(!FCEUSS_SaveMS(&ms,Z_NO_COMPRESSION,saveBackBuffer) || (uint32)ms.size()>arenasize)
+			return 0;
+		memcpy(arena,ms.buf(),ms.size());
+		return ms.size();
+	}
+
+	uint32 size=FCEUSS_StateSize(saveBackBuffer);
+	if(size>arenasize)
+		return 0;
+
+	if(capture && trackwrites)
+	{
+		if(!trackingbuilt)
+			BuildTracking();
+		if(*capture>=firstcapture && !memcmp(arena,"FCSX",4) && FCEU_de32lsb(arena+4)==size-16)
+			since=*capture;
+		*capture=FCEUSS_NextCapture++;
+	}
+
+	uint8 *dst=arena+16;
+
+	FCEUPPU_SaveState();
+	FCEUSND_SaveState();
+	dst=CopyStateChunk(dst,1,SFCPU,since);
+	dst=CopyStateChunk(dst,2,SFCPUC,since);
+	dst=CopyStateChunk(dst,3,FCEUPPU_STATEINFO,since);
+	dst=CopyStateChunk(dst,31,FCEU_NEWPPU_STATEINFO,since);
+	dst=CopyStateChunk(dst,4,FCEUCTRL_STATEINFO,since);
+	dst=CopyStateChunk(dst,5,FCEUSND_STATEINFO,since);
+	if(saveBackBuffer)
+	{
+		*dst++=8;
+		FCEU_en32lsb(dst,256*256);
+		memcpy(dst+4,XBuf,256*256);
+		dst+=4+256*256;
+	}
+
+	if(SPreSave) SPreSave();
+	dst=CopyStateChunk(dst,0x10,SFMDATA,since);
+	if(SPostSave) SPostSave();
+
+	memcpy(arena,"FCSX",4);
+	FCEU_en32lsb(arena+4,size-16);
+	FCEU_en32lsb(arena+8,FCEU_VERSION_NUMERIC);
+	FCEU_en32lsb(arena+12,(uint32)-1);
+	return size;
+}
+
+#ifdef STATE_SELFTEST
+//Saves the running game with FCEUSS_SaveMS and FCEUSS_SaveArena, changes the
+//CPU registers, loads each state back and prints whether X.PC, X.count and
+//timestampbase came back, and whether PC is stored in host byte order as in
+//states saved by older versions.
+void FCEUSS_SelfTest(void)
+{
+	if(!GameInfo)
+		return;
+
+	uint16 pc=X.PC;
+	int32 count=X.count;
+	uint64 tsb=timestampbase;
+	EMUFILE_MEMORY ms;
+
+	if(!FCEUSS_SaveMS(&ms,Z_NO_COMPRESSION))
+	{
+		printf("state selftest: save failed\n");
+		return;
+	}
+
+	std::vector<uint8> arena(ms.size());
+	uint32 size=FCEUSS_SaveArena(&arena[0],arena.size());
+	if(!size)
+	{
+		printf("state selftest: arena save failed\n");
+		return;
+	}
+
+	uint8 *p=ms.buf();
+	bool native=false;
+	for(int x=16;x+10<=ms.size();x++)
+		if(!memcmp(p+x,"PC\0\0",4) && FCEU_de32lsb(p+x+4)==2)
+		{
+			native=!memcmp(p+x+8,&X.PC,2);
+			break;
+		}
+
+	for(int pass=0;pass<2;pass++)
+	{
+		X.PC=~pc;
+		X.count=~count;
+		timestampbase=~tsb;
+
+		//the result isn't checked, FCEUMOV_PostLoad always fails on this port
+		if(pass==0)
+		{
+			ms.fseek(0,SEEK_SET);
+			FCEUSS_LoadFP(&ms,SSLOADPARAM_NOBACKUP);
+		}
+		else
+		{
+			EMUFILE_MEMORY as(&arena[0],size);
+			FCEUSS_LoadFP(&as,SSLOADPARAM_NOBACKUP);
+		}
+
+		printf("state selftest: %s: PC %04X (saved %04X), count %s, timestampbase %s\n",
+			pass?"FCEUSS_SaveArena":"FCEUSS_SaveMS",X.PC,pc,
+			X.count==count?"ok":"wrong",timestampbase==tsb?"ok":"wrong");
+	}
+	printf("state selftest: PC stored in %s byte order\n",native?"host":"swapped");
+}
+#endif
+
 void FCEUSS_Save(const char *fname, bool display_message)
 {
 	EMUFILE* st = 0;
@@ -645,6 +1018,8 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 {
 	if(!is) return false;
 
+	FCEUSS_InvalidateCaptures();
+
 	//maybe make a backup savestate
 	bool backup = (params == SSLOADPARAM_BACKUP);
 	EMUFILE_MEMORY msBackupSavestate;
@@ -667,7 +1042,8 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 	}
 
 	int totalsize = FCEU_de32lsb(header + 4);
-	int stateversion = FCEU_de32lsb(header + 8);
+	int stateversion = FCEU_de32lsb(header + 8) & ~FCEUSTATE_HEADER_LZ;
+	bool lz = (FCEU_de32lsb(header + 8) & FCEUSTATE_HEADER_LZ) != 0;
 	int comprlen = FCEU_de32lsb(header + 12);
 
 	// reinit memory_savestate
@@ -684,10 +1060,18 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 		if ((int)compressed_buf.size() < comprlen) compressed_buf.resize(comprlen);
 		is->fread(&compressed_buf[0], comprlen);
 
-		uLongf uncomprlen = totalsize;
-		int error = uncompress(memory_savestate.buf(), &uncomprlen, &compressed_buf[0], comprlen);
-		if(error != Z_OK || uncomprlen != totalsize)
-			return false;	// we dont need to restore the backup here because we havent messed with the emulator state yet
+		if(lz)
+		{
+			if(LZDecompress(&compressed_buf[0], comprlen, memory_savestate.buf(), totalsize) != totalsize)
+				return false;
+		}
+		else
+		{
+			uLongf uncomprlen = totalsize;
+			int error = uncompress(memory_savestate.buf(), &uncomprlen, &compressed_buf[0], comprlen);
+			if(error != Z_OK || uncomprlen != totalsize)
+				return false;	// we dont need to restore the backup here because we havent messed with the emulator state yet
+		}
 	} else
 	{
 		// the savestate is not compressed: just read from is to memory_savestate.vec
@@ -867,6 +1251,7 @@ void ResetExState(void (*PreSave)(void), void (*PostSave)(void))
 	SPreSave = PreSave;
 	SPostSave = PostSave;
 	SFEXINDEX=0;
+	InvalidateIndexes();
 }
 
 void AddExState(void *v, uint32 s, int type, const char *desc)
@@ -919,6 +1304,7 @@ void AddExState(void *v, uint32 s, int type, const char *desc)
 		}
 	}
 	SFMDATA[SFEXINDEX].v=0;		// End marker.
+	InvalidateIndexes();
 }
 
 void FCEUI_SelectStateNext(int n)
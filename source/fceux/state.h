@@ -27,10 +27,66 @@ enum ENUM_SSLOADPARAMS
 void FCEUSS_Save(const char *, bool display_message=true);
 bool FCEUSS_Load(const char *, bool display_message=true);
 
- //zlib values: 0 (none) through 9 (max) or -1 (default)
-bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel);
+ //zlib values: 0 (none) through 9 (max) or -1 (default), or FCEU_LZ_COMPRESSION
+ //without the back buffer, a load leaves the screen as it is until the next frame is drawn
+bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel, bool saveBackBuffer=true);
+
+//Size of the uncompressed state FCEUSS_SaveArena would take now, 0 if unknown
+uint32 FCEUSS_StateSize(bool saveBackBuffer=true);
+
+//Saves an uncompressed state into arena without allocating. Returns its size,
+//or 0 if it does not fit in arenasize bytes.
+//With capture, arena is expected to hold the capture it names (0 for none),
+//taken with the same saveBackBuffer. While writes are tracked only the pages
+//of tracked memory written since then are copied, and capture is set to the
+//new one.
+uint32 FCEUSS_SaveArena(uint8 *arena, uint32 arenasize, bool saveBackBuffer=true, uint32 *capture=0);
+
+//Write tracking for incremental captures. RAM, and the cartridge WRAM and
+//CHR RAM while they are only written through CartBW and the PPU, are split
+//into pages, and each write stamps its page with the number of the next
+//capture. Anything that changes them another way (power, reset, loading a
+//state) starts the captures over.
+#define FCEUSTATE_PAGESHIFT 8
+#define FCEUSTATE_MAXTRACKED 8
+
+struct SFTRACKED
+{
+	uint8 *base;
+	uint32 size;
+	uint32 *pages;
+};
+
+extern SFTRACKED FCEUSS_Tracked[FCEUSTATE_MAXTRACKED];
+extern int FCEUSS_TrackedCount;
+extern uint32 FCEUSS_NextCapture;
+
+static INLINE void FCEUSS_MarkWrite(const uint8 *p)
+{
+	for(int x=0;x<FCEUSS_TrackedCount;x++)
+	{
+		size_t offset=p-FCEUSS_Tracked[x].base;
+		if(offset<FCEUSS_Tracked[x].size)
+		{
+			FCEUSS_Tracked[x].pages[offset>>FCEUSTATE_PAGESHIFT]=FCEUSS_NextCapture;
+			return;
+		}
+	}
+}
+
+void FCEUSS_TrackWrites(bool enable);
+void FCEUSS_InvalidateCaptures(void);
+
+//compressionLevel for the fast LZ codec (utils/lz.h) instead of zlib
+#define FCEU_LZ_COMPRESSION (-2)
+
+//set in the version field of the header of states compressed with the LZ codec
+#define FCEUSTATE_HEADER_LZ 0x80000000
 
 bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params);
+#ifdef STATE_SELFTEST
+void FCEUSS_SelfTest(void);
+#endif
 
 extern int CurrentState;
 void FCEUSS_CheckStates(void);
@@ -0,0 +1,178 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+
+#include "../types.h"
+#include "lz.h"
+
+#define MINMATCH 4
+#define MAXOFFSET 0xFFFF
+
+static INLINE uint32 Read32(const uint8 *p)
+{
+	uint32 v;
+	memcpy(&v,p,4);
+	return v;
+}
+
+static INLINE uint32 Hash(uint32 v)
+{
+	return (v*2654435761U)>>(32-LZ_HASHBITS);
+}
+
+static uint8 *PutLength(uint8 *dst, uint32 len)
+{
+	while(len>=255)
+	{
+		*dst++=255;
+		len-=255;
+	}
+	*dst++=len;
+	return dst;
+}
+
+static uint8 *PutSequence(uint8 *dst, const uint8 *lit, uint32 litlen, uint32 offset, uint32 matchlen)
+{
+	uint8 *token=dst++;
+
+	*token=(litlen<15?litlen:15)<<4;
+	if(litlen>=15)
+		dst=PutLength(dst,litlen-15);
+	memcpy(dst,lit,litlen);
+	dst+=litlen;
+
+	if(!matchlen)	//last sequence
+		return dst;
+
+	matchlen-=MINMATCH;
+	*token|=matchlen<15?matchlen:15;
+	*dst++=offset;
+	*dst++=offset>>8;
+	if(matchlen>=15)
+		dst=PutLength(dst,matchlen-15);
+	return dst;
+}
+
+uint32 LZCompress(const uint8 *src, uint32 len, uint8 *dst, void *work)
+{
+	uint32 *table=(uint32 *)work;	//last position of each hashed 4 bytes
+	const uint8 *ip=src, *anchor=src, *end=src+len;
+	const uint8 *limit=len>=MINMATCH?end-MINMATCH:src;
+	uint8 *op=dst;
+
+	memset(table,0,LZ_WORKSIZE);
+
+	while(ip<limit)
+	{
+		uint32 seq=Read32(ip);
+		uint32 h=Hash(seq);
+		const uint8 *ref=src+table[h];
+
+		table[h]=ip-src;
+		if(ref>=ip || ip-ref>MAXOFFSET || Read32(ref)!=seq)
+		{
+			ip+=1+((ip-anchor)>>6);	//skip faster through data that does not compress
+			continue;
+		}
+
+		const uint8 *m=ip+MINMATCH, *r=ref+MINMATCH;
+		while(m+4<=end && Read32(m)==Read32(r))
+		{
+			m+=4;
+			r+=4;
+		}
+		while(m<end && *m==*r)
+		{
+			m++;
+			r++;
+		}
+		while(ip>anchor && ref>src && ip[-1]==ref[-1])
+		{
+			ip--;
+			ref--;
+		}
+
+		op=PutSequence(op,anchor,ip-anchor,ip-ref,m-ip);
+		ip=anchor=m;
+	}
+
+	op=PutSequence(op,anchor,end-anchor,0,0);
+	return op-dst;
+}
+
+static INLINE bool GetLength(const uint8 *&ip, const uint8 *end, uint32 &len)
+{
+	uint32 b;
+	do
+	{
+		if(ip>=end)
+			return false;
+		b=*ip++;
+		len+=b;
+	} while(b==255);
+	return true;
+}
+
+int LZDecompress(const uint8 *src, uint32 len, uint8 *dst, uint32 dstlen)
+{
+	const uint8 *ip=src, *end=src+len;
+	uint8 *op=dst, *oend=dst+dstlen;
+
+	while(ip<end)
+	{
+		uint32 token=*ip++;
+		uint32 litlen=token>>4;
+
+		if(litlen==15 && !GetLength(ip,end,litlen))
+			return -1;
+		if(litlen>(uint32)(end-ip) || litlen>(uint32)(oend-op))
+			return -1;
+		memcpy(op,ip,litlen);
+		op+=litlen;
+		ip+=litlen;
+
+		if(ip==end)	//last sequence
+			break;
+		if(end-ip<2)
+			return -1;
+
+		uint32 offset=ip[0]|(ip[1]<<8);
+		uint32 matchlen=token&15;
+		ip+=2;
+
+		if(matchlen==15 && !GetLength(ip,end,matchlen))
+			return -1;
+		matchlen+=MINMATCH;
+		if(!offset || offset>(uint32)(op-dst) || matchlen>(uint32)(oend-op))
+			return -1;
+
+		//an overlapping match repeats the last offset bytes; copy them in
+		//doubling blocks
+		const uint8 *ref=op-offset;
+		while(matchlen>offset)
+		{
+			memcpy(op,ref,offset);
+			op+=offset;
+			matchlen-=offset;
+			offset+=offset;
+		}
+		memcpy(op,ref,matchlen);
+		op+=matchlen;
+	}
+	return op-dst;
+}
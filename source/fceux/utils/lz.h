@@ -0,0 +1,22 @@
+#ifndef _LZ_H
+#define _LZ_H
+
+#include "../types.h"
+
+//Fast LZ77 codec for savestates. A compressed block is a series of
+//sequences: a token byte (literal count << 4 | match length - 4, where 15
+//means more length bytes follow, each 255 meaning another), the literals,
+//a 16 bit little endian match offset and the extra match length bytes.
+//The last sequence has only literals.
+
+#define LZ_HASHBITS 12
+#define LZ_WORKSIZE (sizeof(uint32) << LZ_HASHBITS)	//bytes of work memory for LZCompress
+#define LZ_BOUND(len) ((len) + (len) / 255 + 16)	//largest compressed size of len bytes
+
+//Returns the compressed size. dst must hold LZ_BOUND(len) bytes.
+uint32 LZCompress(const uint8 *src, uint32 len, uint8 *dst, void *work);
+
+//Returns the decompressed size, or -1 if src is corrupt or does not fit in dstlen bytes.
+int LZDecompress(const uint8 *src, uint32 len, uint8 *dst, uint32 dstlen);
+
+#endif
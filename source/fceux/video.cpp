@@ -62,13 +62,20 @@
 //64-127 is the most-used emphasis setting per frame
 //128-195 is the palette with no emphasis
 //196-255 is the palette with all emphasis bits on
-u8 *XBuf=NULL; //used for current display
-u8 *XBackBuf=NULL; //ppu output is stashed here before drawing happens
+u8 *XBuf=NULL; //used for current display (ppu output only, overlays go to XOverlay)
 u8 *XDBuf=NULL; //corresponding to XBuf but with deemph bits
-u8 *XDBackBuf=NULL; //corresponding to XBackBuf but with deemph bits
 int ClipSidesOffset=0;	//Used to move displayed messages when Clips left and right sides is checked
 static u8 *xbsave=NULL;
 
+//XOverlay:
+//messages, status icons, input display etc are drawn here instead of into XBuf.
+//a scanline is copied from XBuf the first time it is drawn on in a frame, so the
+//overlay drawing can still blend with the picture underneath. the blitter takes
+//dirty scanlines from XOverlay and everything else straight from XBuf.
+u8 *XOverlay=NULL;
+static u8 overlayDirty[256];
+static int overlayFirst=256, overlayLast=-1; //range of dirty scanlines
+
 GUIMESSAGE guiMessage;
 GUIMESSAGE subtitleMessage;
 
@@ -93,18 +100,14 @@ void FCEU_KillVirtualVideo(void)
 	{
 		FCEU_afree(XBuf); XBuf = NULL;
 	}
-	if ( XBackBuf )
+	if ( XOverlay )
 	{
-		FCEU_afree(XBackBuf); XBackBuf = NULL;
+		FCEU_afree(XOverlay); XOverlay = NULL;
 	}
 	if ( XDBuf )
 	{
 		FCEU_afree(XDBuf); XDBuf = NULL;
 	}
-	if ( XDBackBuf )
-	{
-		FCEU_afree(XDBackBuf); XDBackBuf = NULL;
-	}
 	//printf("Video Core Cleanup\n");
 }
 
@@ -121,29 +124,82 @@ int FCEU_InitVirtualVideo(void)
 		return 1;
 	
 	XBuf = (u8*)FCEU_amalloc(256 * 256);
-	XBackBuf = (u8*)FCEU_amalloc(256 * 256);
+	XOverlay = (u8*)FCEU_amalloc(256 * 256);
 	XDBuf = (u8*)FCEU_amalloc(256 * 256);
-	XDBackBuf = (u8*)FCEU_amalloc(256 * 256);
 
 	xbsave = XBuf;
 
 	memset(XBuf,128,256*256);
-	memset(XBackBuf,128,256*256);
 	memset(XDBuf,0,256*256);
-	memset(XDBackBuf,0,256*256);
+	FCEU_OverlayClear();
 
 	return 1;
 }
 
+void FCEU_OverlayClear(void)
+{
+	if(overlayLast >= overlayFirst)
+		memset(overlayDirty + overlayFirst, 0, overlayLast - overlayFirst + 1);
+	overlayFirst = 256;
+	overlayLast = -1;
+}
+
+//marks scanline `line` of layer and the `lines` below it as overlay content.
+//must be called before drawing there. does nothing unless layer is XOverlay
+void FCEU_OverlayMark(const uint8 *layer, int line, int lines)
+{
+	if(!XOverlay || !XBuf || layer != XOverlay)
+		return;
+
+	//one extra line in case a row runs over the right edge
+	int first = line;
+	int last = line + lines;
+	if(first < 0) first = 0;
+	if(last > 255) last = 255;
+	if(first > last)
+		return;
+
+	for(int y = first; y <= last; y++)
+	{
+		if(overlayDirty[y])
+			continue;
+		memcpy(XOverlay + (y << 8), XBuf + (y << 8), 256);
+		overlayDirty[y] = 1;
+	}
+
+	if(first < overlayFirst) overlayFirst = first;
+	if(last > overlayLast) overlayLast = last;
+}
+
+//scanline y of frame, with the overlay on top when frame is XBuf
+const uint8 *FCEU_OverlayLine(const uint8 *frame, int y)
+{
+	if(frame == XBuf && overlayDirty[y])
+		return XOverlay + (y << 8);
+	return frame + (y << 8);
+}
+
+//copies XBuf with the overlay on top into dst
+void FCEU_OverlayCopy(uint8 *dst)
+{
+	memcpy(dst, XBuf, 256*256);
+	for(int y = overlayFirst; y <= overlayLast; y++)
+	{
+		if(overlayDirty[y])
+			memcpy(dst + (y << 8), XOverlay + (y << 8), 256);
+	}
+}
+
 #ifdef FRAMESKIP
 void FCEU_PutImageDummy(void)
 {
+	FCEU_OverlayClear();
 	ShowFPS();
 	if(GameInfo->type!=GIT_NSF)
 	{
-		FCEU_DrawNTSCControlBars(XBuf);
-		FCEU_DrawSaveStates(XBuf);
-		FCEU_DrawMovies(XBuf);
+		FCEU_DrawNTSCControlBars(XOverlay);
+		FCEU_DrawSaveStates(XOverlay);
+		FCEU_DrawMovies(XOverlay);
 	}
 	if(guiMessage.howlong) guiMessage.howlong--; /* DrawMessage() */
 }
@@ -162,11 +218,17 @@ void FCEUI_SaveSnapshotAs(void)
 
 static void ReallySnap(void)
 {
+#ifdef GEKKO
+	//the driver reports when the file has actually been written
+	if(!FCEUD_SaveSnapshot(XBuf))
+		FCEU_DispMessage("Error saving screen snapshot.",0);
+#else
 	int x=SaveSnapshot();
 	if(!x)
 		FCEU_DispMessage("Error saving screen snapshot.",0);
 	else
 		FCEU_DispMessage("Screen snapshot %d saved.",0,x-1);
+#endif
 }
 
 static uint32 GetButtonColor(uint32 held, uint32 c, uint32 ci, int bit)
@@ -207,6 +269,10 @@ void FCEU_PutImage(void)
 		}
 		dosnapsave=0;
 	}
+
+	//XBuf is left untouched from here on, so the paused frame can be redrawn from it
+	FCEU_OverlayClear();
+
 	if(GameInfo->type==GIT_NSF)
 	{
 		DrawNSF(XBuf);
@@ -224,10 +290,6 @@ void FCEU_PutImage(void)
 	}
 	else
 	{
-		//Save backbuffer before overlay stuff is written.
-		if(!FCEUI_EmulationPaused())
-			memcpy(XBackBuf, XBuf, 256*256);
-
 		//Some messages need to be displayed before the avi is dumped
 		DrawMessage(true);
 
@@ -246,25 +308,26 @@ void FCEU_PutImage(void)
 		if (!FCEUI_AviEnableHUDrecording()) snapAVI();
 
 		if(GameInfo->type==GIT_VSUNI)
-			FCEU_VSUniDraw(XBuf);
+			FCEU_VSUniDraw(XOverlay);
 
-		FCEU_DrawSaveStates(XBuf);
-		FCEU_DrawMovies(XBuf);
-		FCEU_DrawLagCounter(XBuf);
-		FCEU_DrawNTSCControlBars(XBuf);
-		FCEU_DrawRecordingStatus(XBuf);
+		FCEU_DrawSaveStates(XOverlay);
+		FCEU_DrawMovies(XOverlay);
+		FCEU_DrawLagCounter(XOverlay);
+		FCEU_DrawNTSCControlBars(XOverlay);
+		FCEU_DrawRecordingStatus(XOverlay);
 		ShowFPS();
 	}
 
 	if(FCEUD_ShouldDrawInputAids())
-		FCEU_DrawInput(XBuf);
+		FCEU_DrawInput(XOverlay);
 
 	//Fancy input display code
 	if(input_display)
 	{
 		int i, j;
-		uint8 *t = XBuf+(FSettings.LastSLine-9)*256 + 20;		//mbg merge 7/17/06 changed t to uint8*
+		uint8 *t = XOverlay+(FSettings.LastSLine-9)*256 + 20;		//mbg merge 7/17/06 changed t to uint8*
 		if(input_display > 4) input_display = 4;
+		FCEU_OverlayMark(XOverlay, FSettings.LastSLine-9, 9);
 		for(int controller = 0; controller < input_display; controller++, t += 56)
 		{
 			for(i = 0; i < 34;i++)
@@ -493,10 +556,11 @@ uint32 GetScreenPixel(int x, int y, bool usebackup) {
 	if (((x < 0) || (x > 255)) || ((y < 0) || (y > 255)))
 		return -1;
 
+	//XBuf has no overlays, so it is what the backup used to hold
 	if (usebackup)
-		FCEUD_GetPalette(XBackBuf[(y*256)+x],&r,&g,&b);
-	else
 		FCEUD_GetPalette(XBuf[(y*256)+x],&r,&g,&b);
+	else
+		FCEUD_GetPalette(FCEU_OverlayLine(XBuf,y)[x],&r,&g,&b);
 
 
 	return ((int) (r) << 16) | ((int) (g) << 8) | (int) (b);
@@ -508,9 +572,9 @@ int GetScreenPixelPalette(int x, int y, bool usebackup) {
 		return -1;
 
 	if (usebackup)
-		return XBackBuf[(y*256)+x] & 0x3f;
-	else
 		return XBuf[(y*256)+x] & 0x3f;
+	else
+		return FCEU_OverlayLine(XBuf,y)[x] & 0x3f;
 
 }
 
@@ -773,6 +837,6 @@ void ShowFPS(void)
 	}
 	boopcount++;
 
-	DrawTextTrans(XBuf + ((256 - ClipSidesOffset) - 40) + (FSettings.FirstSLine + 4) * 256, 256, (uint8*)fpsmsg, 0xA0);
+	DrawTextTransLayer(XOverlay, XOverlay + ((256 - ClipSidesOffset) - 40) + (FSettings.FirstSLine + 4) * 256, 256, (uint8*)fpsmsg, 0xA0);
 #endif
 }
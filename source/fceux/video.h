@@ -16,13 +16,18 @@ int GetScreenPixelPalette(int x, int y, bool usebackup);
 typedef uint8 xfbuf_t;
 
 extern uint8 *XBuf;
-extern uint8 *XBackBuf;
+extern uint8 *XOverlay;
 extern uint8 *XDBuf;
-extern uint8 *XDBackBuf;
 extern xfbuf_t *XFBuf;
 
 extern int ClipSidesOffset;
 
+//overlay layer for everything drawn on top of the ppu output
+void FCEU_OverlayClear(void);
+void FCEU_OverlayMark(const uint8 *layer, int line, int lines);
+const uint8 *FCEU_OverlayLine(const uint8 *frame, int y);
+void FCEU_OverlayCopy(uint8 *dst);
+
 struct GUIMESSAGE
 {
 	//countdown for gui messages
@@ -28,6 +28,7 @@
 #include "driver.h"
 #include "cart.h"
 #include "ines.h"
+#include "video.h"
 
 #include <cstring>
 #include <cstdio>
@@ -392,6 +393,7 @@ void FCEU_VSUniDraw(uint8 *XBuf) {
 
 	if (DIPS_howlong-- <= 0) return;
 
+	FCEU_OverlayMark(XBuf, 12, 24);
 	dest = (uint32*)(XBuf + 256 * 12 + 164);
 	for (y = 24; y; y--, dest += (256 - 72) >> 2) {
 		for (x = 72 >> 2; x; x--, dest++)
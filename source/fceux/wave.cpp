@@ -7,9 +7,41 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
+#ifdef GEKKO
+static bool soundlog=false;
+#else
 static FILE *soundlog=0;
+#endif
 static long wsize;
+static uint32 wrate;
+
+static void PutLE(uint8 *p, uint32 v, int bytes)
+{
+ while(bytes--)
+ {
+  *p++=v&0xFF;
+  v>>=8;
+ }
+}
+
+/* 16-bit mono PCM at the rate the log was started with. */
+static void MakeWaveHeader(uint8 *h, uint32 datasize)
+{
+ memcpy(h,"RIFF",4);
+ PutLE(h+4,datasize+36,4);
+ memcpy(h+8,"WAVEfmt ",8);
+ PutLE(h+16,0x10,4);
+ PutLE(h+20,1,2);     // PCM
+ PutLE(h+22,1,2);     // Monophonic
+ PutLE(h+24,wrate,4);
+ PutLE(h+28,wrate<<1,4);
+ PutLE(h+32,2,2);
+ PutLE(h+34,16,2);
+ memcpy(h+36,"data",4);
+ PutLE(h+40,datasize,4);
+}
 
 /* Checking whether the file exists before wiping it out is left up to the
    reader..err...I mean, the driver code, if it feels so inclined(I don't feel
@@ -43,10 +75,19 @@ void FCEU_WriteWaveData(int32 *Buffer, int Count)
   dest++;
   Buffer++;
  }
+#ifdef GEKKO
+ //the header is sized from what the driver wrote, so a failed write just ends the log
+ if(soundlog && FCEUD_WaveLogWrite(temp,Count*sizeof(int16))<0)
+ {
+	 FCEUI_EndWaveRecord();
+	 FCEU_DispMessage("Error writing sound log!",0);
+ }
+#else
  if(soundlog)
 	 wsize+=fwrite(temp,1,Count*sizeof(int16),soundlog);
+#endif
 
-    #ifdef __WIN_DRIVER__
+    #if defined(__WIN_DRIVER__) || defined(GEKKO)
 	if(FCEUI_AviIsRecording())
 	{
 		FCEUI_AviSoundUpdate((void*)temp, Count);
@@ -56,76 +97,51 @@ void FCEU_WriteWaveData(int32 *Buffer, int Count)
 
 int FCEUI_EndWaveRecord()
 {
- long s;
+ uint8 header[44];
 
  if(!soundlog) return 0;
- s=ftell(soundlog)-8;
- fseek(soundlog,4,SEEK_SET);
- fputc(s&0xFF,soundlog);
- fputc((s>>8)&0xFF,soundlog);
- fputc((s>>16)&0xFF,soundlog);
- fputc((s>>24)&0xFF,soundlog);
-
- fseek(soundlog,0x28,SEEK_SET);
- s=wsize;
- fputc(s&0xFF,soundlog);
- fputc((s>>8)&0xFF,soundlog);
- fputc((s>>16)&0xFF,soundlog);
- fputc((s>>24)&0xFF,soundlog);
+#ifdef GEKKO
+ wsize=FCEUD_WaveLogFlush()-44;
+ if(wsize<0) wsize=0;
+#endif
+ MakeWaveHeader(header,wsize);
 
+#ifdef GEKKO
+ FCEUD_WaveLogClose(header,44);
+ soundlog=false;
+#else
+ fseek(soundlog,0,SEEK_SET);
+ fwrite(header,1,44,soundlog);
  fclose(soundlog);
  soundlog=0;
+#endif
  return 1;
 }
 
 
 bool FCEUI_BeginWaveRecord(const char *fn)
 {
- int r;
+ uint8 header[44];
 
- if(!(soundlog=FCEUD_UTF8fopen(fn,"wb")))
-  return false;
+ /* The sizes are filled in by FCEUI_EndWaveRecord(). */
+ wrate=FSettings.SndRate;
  wsize=0;
+ MakeWaveHeader(header,0);
 
-
- /* Write the header. */
- fputs("RIFF",soundlog);
- fseek(soundlog,4,SEEK_CUR);  // Skip size
- fputs("WAVEfmt ",soundlog);
-
- fputc(0x10,soundlog);
- fputc(0,soundlog);
- fputc(0,soundlog);
- fputc(0,soundlog);
-
- fputc(1,soundlog);     // PCM
- fputc(0,soundlog);
-
- fputc(1,soundlog);     // Monophonic
- fputc(0,soundlog);
-
- r=FSettings.SndRate;
- fputc(r&0xFF,soundlog);
- fputc((r>>8)&0xFF,soundlog);
- fputc((r>>16)&0xFF,soundlog);
- fputc((r>>24)&0xFF,soundlog);
- r<<=1;
- fputc(r&0xFF,soundlog);
- fputc((r>>8)&0xFF,soundlog);
- fputc((r>>16)&0xFF,soundlog);
- fputc((r>>24)&0xFF,soundlog);
- fputc(2,soundlog);
- fputc(0,soundlog);
- fputc(16,soundlog);
- fputc(0,soundlog);
-
- fputs("data",soundlog);
- fseek(soundlog,4,SEEK_CUR);
+#ifdef GEKKO
+ if(!(soundlog=FCEUD_WaveLogOpen(fn)))
+  return false;
+ FCEUD_WaveLogWrite(header,44);
+#else
+ if(!(soundlog=FCEUD_UTF8fopen(fn,"wb")))
+  return false;
+ fwrite(header,1,44,soundlog);
+#endif
 
  return true;
 }
 
 bool FCEUI_WaveRecordRunning(void)
 {
-	return (soundlog != NULL);
+	return (soundlog != 0);
 }
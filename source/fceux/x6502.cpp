@@ -23,6 +23,7 @@
 #include "fceu.h"
 #include "debug.h"
 #include "sound.h"
+#include "state.h"
 #ifdef _S9XLUA_H
 #include "fceulua.h"
 #endif
@@ -69,6 +70,7 @@ static INLINE uint8 RdRAM(unsigned int A)
 static INLINE void WrRAM(unsigned int A, uint8 V)
 {
 	RAM[A]=V;
+	FCEUSS_MarkWrite(&RAM[A]);
 	#ifdef _S9XLUA_H
 	CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
 	#endif
@@ -16,6 +16,7 @@
 #include <sys/time.h>
 #include <gctypes.h>
 #include <ogc/system.h>
+#include <ogc/lwp_watchdog.h>
 #include <fat.h>
 #include <wiiuse/wpad.h>
 #include <malloc.h>
@@ -37,6 +38,10 @@
 #include "gcaudio.h"
 #include "gcvideo.h"
 #include "pad.h"
+#include "pngwriter.h"
+#include "statewriter.h"
+#include "recorder.h"
+#include "rewind.h"
 #include "filelist.h"
 #include "gui/gui.h"
 #include "utils/wiidrc.h"
@@ -78,6 +83,7 @@ char appPath[1024] = { 0 };
 
 int frameskip = 0;
 int fastforward = 0;
+int rewinding = 0;
 unsigned char * nesrom = NULL;
 
 /****************************************************************************
@@ -88,6 +94,9 @@ static void ExitCleanup()
 	ShutdownAudio();
 	StopGX();
 
+	RecorderStop();
+	WaitPngWriter(); // finish any queued screenshots
+	WaitStateWriter();
 	HaltDeviceThread();
 	UnmountAllFAT();
 
@@ -391,6 +400,8 @@ int main(int argc, char *argv[])
 	
 	SetupPads();
 	InitDeviceThread();
+	InitPngWriter();
+	InitStateWriter();
 	MountAllFAT(); // Initialize libFAT for SD and USB
 	
 	#ifdef HW_RVL
@@ -466,6 +477,7 @@ int main(int argc, char *argv[])
 			case 0: FCEUI_SetSoundQuality(0); break;
 			case 1: FCEUI_SetSoundQuality(1); break;
 			case 2: FCEUI_SetSoundQuality(2); break;
+			case 3: FCEUI_SetSoundQuality(3); break;
 		}
 
 		if (GCSettings.swapduty == 0)
@@ -516,13 +528,18 @@ int main(int argc, char *argv[])
 		// since we're starting emulation again
 		HaltDeviceThread();
 
+		if(GCSettings.recording)
+			RecorderStartAuto(); // each emulation session is its own recording
+
 		ResetVideo_Emu();
 		SetControllers();
 		setFrameTimer(); // set frametimer method before emulation
 		SetPalette();
 		FCEUI_SetSoundVolume(GCSettings.soundvolume);
 		FCEUI_SetLowPass(GCSettings.lowpass == 1);
+		SetRateControl(GCSettings.ratecontrol == 1);
 		FCEUI_DisableSpriteLimitation(GCSettings.nospritelimit ^ 0);
+		RewindSetup(GCSettings.Rewind == 1);
 
 		fskip=0;
 		fskipc=0;
@@ -564,7 +581,15 @@ int main(int argc, char *argv[])
 			//CAK: Currently this is designed to be used before the frame is emulated
 			Check3D();
 
+			if(rewinding)
+				RewindStep(); // then emulate the frame after the snapshot
+
+			u64 emustart = gettime();
 			FCEUI_Emulate(&gfx, &sound, &ssize, fskip);
+			videoTimings.emulate = diff_usec(emustart, gettime());
+
+			if(!rewinding)
+				RewindCapture();
 
 			if (!shutter_3d_mode && !anaglyph_3d_mode)
 				FCEUD_Update(gfx, sound, ssize);
@@ -588,6 +613,7 @@ int main(int argc, char *argv[])
 			if(ConfigRequested)
 			{
 				ConfigRequested = 0;
+				RecorderStop();
 				ResetVideo_Menu();
 				break;
 			}
@@ -106,6 +106,7 @@ struct SGCSettings{
 	char	CoverFolder[MAXPATHLEN]; 	// Path to cover files
 	char	ArtworkFolder[MAXPATHLEN]; 	// Path to artwork files
 	int		HideRAMSaving;
+	int		StateStore;	// states are saved to a deduplicated store per game
 	int		AutoloadGame;
 
 	float	zoomHor; // Horizontal zoom amount
@@ -114,9 +115,12 @@ struct SGCSettings{
 	int		render;		// 0 - Default, 1 - Original (240p)
 	int		bilinear;    // Bilinear filtering
 	int		hideoverscan; // 0 = None, 1 = Vertical, 2 = Horizontal, 3 = Both
+	int		scaler;		// 0 = Off, 1 = Scale2x, 2 = Scale3x, 3 = Scale4x
 	int		Controller;
 	int		FastForward;
 	int		FastForwardButton;
+	int		Rewind;
+	int		RewindButton;	// as FastForwardButton, the right stick is pushed left
 	int		currpal;
 	int		ntsccolor;
 	int		crosshair;
@@ -128,6 +132,7 @@ struct SGCSettings{
 	int		soundquality;
 	int		lowpass;
 	int		swapduty;
+	int		ratecontrol;	// dynamic audio rate control
 	int		overclock;
 	int		nospritelimit;
 	int		gamegenie;
@@ -137,6 +142,8 @@ struct SGCSettings{
 	int		SFXVolume;
 	int 	language;
 	int		PreviewImage;
+	int		recording;	// 0 = Off, 1 = Y4M + WAV, 2 = Indexed + WAV
+	int		recordpolicy; // 0 = Drop frames, 1 = Slow down emulation
 
 };
 
@@ -154,6 +161,7 @@ extern int frameskip;
 extern int fskip;
 extern int fskipc;
 extern int fastforward;
+extern int rewinding;
 extern bool romLoaded;
 extern bool isWiiVC;
 static inline bool IsWiiU(void)
@@ -69,17 +69,28 @@ int selectLoadedFile = 0;
 // device thread
 static lwp_t devicethread = LWP_THREAD_NULL;
 static bool deviceHalt = true;
+static mutex_t deviceLock = LWP_MUTEX_NULL;
+static bool deviceWanted = false; // resumed by the menu or a SaveFile
+static int deviceHolds = 0; // background writers using a device
 
 /****************************************************************************
  * ResumeDeviceThread
  *
- * Signals the device thread to start, and resumes the thread.
+ * Signals the device thread to start, and resumes the thread - once no
+ * background writer holds it halted.
  ***************************************************************************/
 void
 ResumeDeviceThread()
 {
-	deviceHalt = false;
-	LWP_ResumeThread(devicethread);
+	LWP_MutexLock(deviceLock);
+	deviceWanted = true;
+
+	if(deviceHolds == 0)
+	{
+		deviceHalt = false;
+		LWP_ResumeThread(devicethread);
+	}
+	LWP_MutexUnlock(deviceLock);
 }
 
 /****************************************************************************
@@ -91,7 +102,10 @@ void
 HaltDeviceThread()
 {
 #ifdef HW_RVL
+	LWP_MutexLock(deviceLock);
+	deviceWanted = false;
 	deviceHalt = true;
+	LWP_MutexUnlock(deviceLock);
 
 	// wait for thread to finish
 	while(!LWP_ThreadIsSuspended(devicethread))
@@ -99,6 +113,42 @@ HaltDeviceThread()
 #endif
 }
 
+/****************************************************************************
+ * HoldDeviceThread
+ *
+ * Halts the device thread while a background writer uses a device, without
+ * changing whether the menu wants it running. Every hold is ended with a
+ * ReleaseDeviceThread.
+ ***************************************************************************/
+void
+HoldDeviceThread()
+{
+#ifdef HW_RVL
+	LWP_MutexLock(deviceLock);
+	deviceHolds++;
+	deviceHalt = true;
+	LWP_MutexUnlock(deviceLock);
+
+	while(!LWP_ThreadIsSuspended(devicethread))
+		usleep(THREAD_SLEEP);
+#endif
+}
+
+void
+ReleaseDeviceThread()
+{
+#ifdef HW_RVL
+	LWP_MutexLock(deviceLock);
+
+	if(--deviceHolds == 0 && deviceWanted)
+	{
+		deviceHalt = false;
+		LWP_ResumeThread(devicethread);
+	}
+	LWP_MutexUnlock(deviceLock);
+#endif
+}
+
 /****************************************************************************
  * HaltParseThread
  *
@@ -189,6 +239,7 @@ parsecallback (void *arg)
 void
 InitDeviceThread()
 {
+	LWP_MutexInit(&deviceLock, false);
 #ifdef HW_RVL
 	LWP_CreateThread (&devicethread, devicecallback, NULL, NULL, 0, 40);
 #endif
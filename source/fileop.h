@@ -21,6 +21,8 @@
 void InitDeviceThread();
 void ResumeDeviceThread();
 void HaltDeviceThread();
+void HoldDeviceThread();
+void ReleaseDeviceThread();
 void HaltParseThread();
 void MountAllFAT();
 void UnmountAllFAT();
@@ -8,54 +8,77 @@
  * gcaudio.cpp
  *
  * Audio driver
+ *
+ * mixbuffer is a single producer / single consumer ring of stereo samples.
+ * PlaySound (emulation thread) only moves mixhead, MixerCollect (DMA
+ * interrupt) only moves mixtail. Both are free running counters, so the
+ * fill level is always mixhead - mixtail.
  ****************************************************************************/
 
 #include <gccore.h>
 #include <string.h>
 #include <asndlib.h>
 #include "fceusupport.h"
+#include "gcaudio.h"
+
+#define MIXBUFFER_SIZE 4096 // stereo samples, power of two
+#define MIXBUFFER_MASK (MIXBUFFER_SIZE - 1)
+#define DMA_BUFFER_SIZE 2048 // bytes per DMA period
+#define RATECONTROL_TARGET 1536 // stereo samples, 3 DMA periods
+#define RATECONTROL_MAX 5000 // ppm (0.5%)
+
+// Single core - only the compiler could reorder the ring accesses
+#define MixerBarrier() __asm__ __volatile__ ("" ::: "memory")
 
 extern int ScreenshotRequested;
 extern int ConfigRequested;
-static u8 soundbuffer[3][2048] ATTRIBUTE_ALIGN(32);
-static u8 mixbuffer[16000];
-static int mixhead = 0;
-static int mixtail = 0;
+static u8 soundbuffer[3][DMA_BUFFER_SIZE] ATTRIBUTE_ALIGN(32);
+static u32 mixbuffer[MIXBUFFER_SIZE] ATTRIBUTE_ALIGN(32);
+static volatile u32 mixhead = 0;
+static volatile u32 mixtail = 0;
 static int whichab = 0;
 static int IsPlaying = 0;
 static int samplerate;
+static struct st_audiostats audiostats;
+static struct st_ratecontrol ratecontrol = { 0, RATECONTROL_TARGET, RATECONTROL_MAX, RATECONTROL_TARGET, 0 };
 
 /****************************************************************************
  * MixerCollect
  *
  * Collects sound samples from mixbuffer and puts them into outbuffer
- * Makes sure to align them to 32 bytes for AUDIO_InitDMA
+ * Only takes whole 32 byte blocks, as required by AUDIO_InitDMA
  ***************************************************************************/
 static int MixerCollect( u8 *outbuffer, int len )
 {
 	u32 *dst = (u32 *)outbuffer;
-	u32 *src = (u32 *)mixbuffer;
-	int done = 0;
+	u32 tail = mixtail;
+	u32 avail = mixhead - tail;
+	u32 want = len >> 2;
+	u32 count;
+
+	MixerBarrier(); // read mixhead before the samples it covers
 
-	// Always clear output buffer
-	memset(outbuffer, 0, len);
+	count = (avail < want ? avail : want) & ~7;
 
-	while ( ( mixtail != mixhead ) && ( done < len ) )
+	audiostats.periods++;
+
+	if (count < want)
+		audiostats.underruns++;
+
+	if (!count)
 	{
-		*dst++ = src[mixtail++];
-		if (mixtail == 4000) mixtail = 0;
-		done += 4;
+		// nothing to play - keep the DMA running with half a period of silence
+		audiostats.zerofilled++;
+		memset(outbuffer, 0, len >> 1);
+		return len >> 1;
 	}
 
-	// Realign to 32 bytes for DMA
-	mixtail -= ((done&0x1f) >> 2);
-	if (mixtail < 0)
-		mixtail += 4000;
-	done &= ~0x1f;
-	if (!done)
-		return len >> 1;
+	for (u32 i = 0; i < count; i++)
+		dst[i] = mixbuffer[(tail + i) & MIXBUFFER_MASK];
 
-	return done;
+	MixerBarrier(); // finish reading before the space is handed back
+	mixtail = tail + count;
+	return count << 2;
 }
 
 /****************************************************************************
@@ -67,7 +90,7 @@ static void AudioSwitchBuffers()
 {
 	if ( !ScreenshotRequested && !ConfigRequested ) {
 		IsPlaying = 1;
-		int len = MixerCollect( soundbuffer[whichab], 2048 );
+		int len = MixerCollect( soundbuffer[whichab], DMA_BUFFER_SIZE );
 		DCFlushRange(soundbuffer[whichab], len);
 		AUDIO_InitDMA((u32)soundbuffer[whichab], len);
 		whichab ^= 1;
@@ -91,20 +114,23 @@ void InitialiseAudio()
 	#else
 	ASND_Init();
 	#endif
-	memset(soundbuffer, 0, 2048*3);
-	memset(mixbuffer, 0, 16000);
+	memset(soundbuffer, 0, sizeof(soundbuffer));
+	memset(mixbuffer, 0, sizeof(mixbuffer));
 }
 
 /****************************************************************************
  * ResetAudio
  *
  * Reset audio output when loading a new game
+ * Called from the menu, while the DMA callback is not collecting samples
  ***************************************************************************/
 void ResetAudio()
 {
-	memset(soundbuffer, 0, 2048*3);
-	memset(mixbuffer, 0, 16000);
+	memset(soundbuffer, 0, sizeof(soundbuffer));
+	memset(mixbuffer, 0, sizeof(mixbuffer));
 	mixhead = mixtail = 0;
+	memset(&audiostats, 0, sizeof(audiostats));
+	ratecontrol.average = ratecontrol.target;
 }
 
 /****************************************************************************
@@ -150,32 +176,135 @@ void ShutdownAudio()
 	AUDIO_StopDMA();
 }
 
+/****************************************************************************
+ * UpdateRateControl
+ *
+ * Dynamic rate control - once per frame, the emulator's output rate is
+ * stretched in proportion to how far the (smoothed) fill level is from the
+ * target, by at most maxadjust. A full ring slows the output down, an
+ * emptying one speeds it up, so the level settles near the target instead
+ * of drifting into underruns or overruns.
+ ***************************************************************************/
+static void UpdateRateControl()
+{
+	int adjust = 0;
+
+	if (ratecontrol.enabled)
+	{
+		ratecontrol.average += (AudioBufferFill() - ratecontrol.average) / 8;
+		adjust = (ratecontrol.average - ratecontrol.target) * ratecontrol.maxadjust / ratecontrol.target;
+
+		if (adjust > ratecontrol.maxadjust)
+			adjust = ratecontrol.maxadjust;
+		else if (adjust < -ratecontrol.maxadjust)
+			adjust = -ratecontrol.maxadjust;
+	}
+
+	if (adjust != ratecontrol.adjust)
+	{
+		ratecontrol.adjust = adjust;
+		FCEUI_SetSoundRateAdjust(adjust);
+	}
+}
+
 /****************************************************************************
  * PlaySound
  *
  * Puts incoming mono samples into mixbuffer
  * Splits mono samples into two channels (stereo)
+ * Samples that do not fit are dropped - the ring is never overwritten
  ****************************************************************************/
 void PlaySound( int32 *Buffer, int count )
 {
 	int i;
 	u16 sample;
-	u32 *dst = (u32 *)mixbuffer;
+	u32 head = mixhead;
+	u32 space = MIXBUFFER_SIZE - (head - mixtail);
+
+	MixerBarrier(); // read mixtail before reusing the space it frees
+
+	if ((u32)count > space) {
+		audiostats.overruns++;
+		audiostats.dropped += count - space;
+		count = space;
+	}
 
 	for( i = 0; i < count; i++ ) {
 		sample = Buffer[i] & 0xffff;
-		dst[mixhead++] = sample | ( sample << 16);
-		if (mixhead == 4000) {
-			mixhead = 0;
-		}
+		mixbuffer[(head + i) & MIXBUFFER_MASK] = sample | ( sample << 16);
 	}
 
+	MixerBarrier(); // write the samples before publishing them
+	mixhead = head + count;
+
+	UpdateRateControl();
+
 	// Restart Sound Processing if stopped
 	if (IsPlaying == 0) {
 		AUDIO_StartDMA();
 	}
 }
 
+/****************************************************************************
+ * AudioBufferFill
+ *
+ * Number of stereo samples waiting in mixbuffer
+ ***************************************************************************/
+int AudioBufferFill()
+{
+	return mixhead - mixtail;
+}
+
+int AudioBufferSize()
+{
+	return MIXBUFFER_SIZE;
+}
+
+/****************************************************************************
+ * AudioStarving
+ *
+ * True while the DMA is running and less than one period is queued
+ ***************************************************************************/
+bool AudioStarving()
+{
+	return IsPlaying && AudioBufferFill() < (DMA_BUFFER_SIZE >> 2);
+}
+
+void GetAudioStats(struct st_audiostats *stats)
+{
+	memcpy(stats, (const void *)&audiostats, sizeof(audiostats));
+}
+
+/****************************************************************************
+ * SetRateControl
+ *
+ * Enables/disables dynamic rate control. target (stereo samples) and
+ * maxadjust (ppm) are left unchanged when 0.
+ ***************************************************************************/
+void SetRateControl(bool enable, int target, int maxadjust)
+{
+	if (target > 0 && target < MIXBUFFER_SIZE)
+	{
+		ratecontrol.target = target;
+		ratecontrol.average = target;
+	}
+	if (maxadjust > 0)
+		ratecontrol.maxadjust = maxadjust;
+
+	ratecontrol.enabled = enable;
+
+	if (!enable && ratecontrol.adjust)
+	{
+		ratecontrol.adjust = 0;
+		FCEUI_SetSoundRateAdjust(0);
+	}
+}
+
+void GetRateControl(struct st_ratecontrol *state)
+{
+	memcpy(state, &ratecontrol, sizeof(ratecontrol));
+}
+
 void UpdateSampleRate(int rate)
 {
 	if(samplerate != rate) {
@@ -10,6 +10,27 @@
  * Audio driver
  ****************************************************************************/
 
+#ifndef _GCAUDIO_H_
+#define _GCAUDIO_H_
+
+#include <gctypes.h>
+
+struct st_audiostats {
+	u32 periods;	// DMA periods started
+	u32 underruns;	// periods that could not be filled completely
+	u32 zerofilled;	// periods played as silence, nothing was queued
+	u32 overruns;	// PlaySound calls that did not fit
+	u32 dropped;	// samples dropped by those calls
+};
+
+struct st_ratecontrol {
+	int enabled;
+	int target;		// fill level aimed for, in stereo samples
+	int maxadjust;	// largest rate change, parts per million
+	int average;	// smoothed fill level after each frame
+	int adjust;		// current rate change, parts per million
+};
+
 void InitialiseAudio();
 void ResetAudio();
 void PlaySound( int32 *Buffer, int samples );
@@ -17,3 +38,11 @@ void SwitchAudioMode(int mode);
 void ShutdownAudio();
 void UpdateSampleRate(int rate);
 void SetSampleRate();
+int AudioBufferFill();
+int AudioBufferSize();
+bool AudioStarving();
+void GetAudioStats(struct st_audiostats *stats);
+void SetRateControl(bool enable, int target = 0, int maxadjust = 0);
+void GetRateControl(struct st_ratecontrol *state);
+
+#endif
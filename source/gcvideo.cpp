@@ -25,8 +25,10 @@
 #include "fceusupport.h"
 #include "gcvideo.h"
 #include "gcaudio.h"
+#include "fceux/video.h"
 #include "menu.h"
 #include "pad.h"
+#include "scaler.h"
 #include "gui/gui.h"
 
 int FDSTimer = 0;
@@ -51,12 +53,17 @@ static unsigned char texturemem[TEXTUREMEM_SIZE] ATTRIBUTE_ALIGN (32);
 static u32 copynow = GX_FALSE;
 static u8 gp_fifo[DEFAULT_FIFO_SIZE] ATTRIBUTE_ALIGN(32);
 static GXTexObj texobj;
+static GXTexObj scaledtexobj; // texture for the upscaling filters
+static u16 *scaledtexture = NULL;
+static int scalefactor = 1;
 static Mtx view;
 static Mtx GXmodelView2D;
 
 u8 * gameScreenPng = NULL;
 int gameScreenPngSize = 0;
 
+struct st_videotimings videoTimings;
+
 bool vmode_60hz = true;
 int UpdateVideo = 1;
 bool progressive = false;
@@ -73,6 +80,8 @@ struct pcpal {
 
 static unsigned int gcpalette[256]; // Much simpler GC palette
 static unsigned short rgb565[256];  // Texture map palette
+static unsigned short emph565[8][256]; // Texture map palette for each emphasis setting (XDBuf)
+static bool emph565Valid = false;
 bool shutter_3d_mode, anaglyph_3d_mode, eye_3d;
 bool AnaglyphPaletteValid = false; //CAK: Has the anaglyph palette below been generated yet?
 static unsigned short anaglyph565[64][64]; //CAK: Texture map left right combination anaglyph palette
@@ -228,6 +237,8 @@ void SyncSpeed()
 	{	
 		while (diff_usec(prev, now) < normaldiff)
 		{
+			if (AudioStarving())
+				break; // the next frame's samples are needed now
 			now = gettime();
 			usleep(50);
 		}
@@ -692,8 +703,26 @@ ResetVideo_Emu ()
 	if (GCSettings.bilinear == 0)
 		GX_InitTexObjLOD(&texobj,GX_NEAR,GX_NEAR_MIP_NEAR,2.5,9.0,0.0,GX_FALSE,GX_FALSE,GX_ANISO_1); // bilinear filtering
 	
-	GX_LoadTexObj (&texobj, GX_TEXMAP0);
 	memset(texturemem, 0, TEXTUREMEM_SIZE); // clear texture memory
+
+	// upscaled texture
+	scalefactor = ScalerFactor(GCSettings.scaler);
+	scaledtexture = ScalerSetup(scalefactor);
+
+	if(scaledtexture)
+	{
+		GX_InitTexObj (&scaledtexobj, scaledtexture, TEX_WIDTH*scalefactor, TEX_HEIGHT*scalefactor, GX_TF_RGB565, GX_CLAMP, GX_CLAMP, GX_FALSE);
+
+		if (GCSettings.bilinear == 0)
+			GX_InitTexObjLOD(&scaledtexobj,GX_NEAR,GX_NEAR_MIP_NEAR,2.5,9.0,0.0,GX_FALSE,GX_FALSE,GX_ANISO_1);
+
+		GX_LoadTexObj (&scaledtexobj, GX_TEXMAP0);
+	}
+	else
+	{
+		scalefactor = 1;
+		GX_LoadTexObj (&texobj, GX_TEXMAP0);
+	}
 }
 
 /****************************************************************************
@@ -728,58 +757,99 @@ void RenderFrame(unsigned char *XBuf)
 	if(GCSettings.hideoverscan >= 2)
 		borderwidth = 8;
 
-	u16 *texture = (unsigned short *)texturemem + (borderheight << 8) + (borderwidth << 2);
-	u8 *src1 = XBuf + (borderheight << 8) + borderwidth;
-	u8 *src2 = XBuf + (borderheight << 8) + borderwidth + 256;
-	u8 *src3 = XBuf + (borderheight << 8) + borderwidth + 512;
-	u8 *src4 = XBuf + (borderheight << 8) + borderwidth + 768;
+	u64 stagestart = gettime();
 
-	// fill the texture
-	for (height = 0; height < 240 - (borderheight << 1); height += 4)
+	// NSF screens are drawn with the plain palette
+	bool emphasis = emph565Valid && GameInfo && GameInfo->type != GIT_NSF;
+
+	if(scaledtexture)
 	{
-		for (width = 0; width < 256 - (borderwidth << 1); width += 4)
+		static const u8 *lines[240];
+		static const u16 *linepalettes[240];
+
+		// HUD overlay lines replace the emulator output where present.
+		// Each emulator line takes the palette for its emphasis bits.
+		for (height = 0; height < 240; height++)
 		{
-			// Row one
-			*texture++ = rgb565[*src1++];
-			*texture++ = rgb565[*src1++];
-			*texture++ = rgb565[*src1++];
-			*texture++ = rgb565[*src1++];
+			lines[height] = FCEU_OverlayLine(XBuf, height);
+			if (emphasis && lines[height] == XBuf + (height << 8))
+				linepalettes[height] = emph565[XDBuf[height << 8] & 7];
+			else
+				linepalettes[height] = rgb565;
+		}
 
-			// Row two
-			*texture++ = rgb565[*src2++];
-			*texture++ = rgb565[*src2++];
-			*texture++ = rgb565[*src2++];
-			*texture++ = rgb565[*src2++];
+		ScalerRender(scaledtexture, lines, linepalettes, scalefactor, borderheight, borderwidth);
+		videoTimings.scale = diff_usec(stagestart, gettime());
 
-			// Row three
-			*texture++ = rgb565[*src3++];
-			*texture++ = rgb565[*src3++];
-			*texture++ = rgb565[*src3++];
-			*texture++ = rgb565[*src3++];
+		stagestart = gettime();
+		DCFlushRange(scaledtexture, TEXTUREMEM_SIZE*scalefactor*scalefactor);
+		GX_LoadTexObj(&scaledtexobj, GX_TEXMAP0); // the stereo renderer may have switched textures
+	}
+	else
+	{
+		u16 *texture = (unsigned short *)texturemem + (borderheight << 8) + (borderwidth << 2);
+		const u8 *src[4];
+		const u8 *dsrc[4];
 
-			// Row four
-			*texture++ = rgb565[*src4++];
-			*texture++ = rgb565[*src4++];
-			*texture++ = rgb565[*src4++];
-			*texture++ = rgb565[*src4++];
+		// fill the texture
+		for (height = 0; height < 240 - (borderheight << 1); height += 4)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				int line = borderheight + height + row;
+
+				// HUD overlay lines replace the emulator output where present.
+				// Emulator lines are looked up by colour and emphasis bits,
+				// HUD lines through the plain palette.
+				src[row] = FCEU_OverlayLine(XBuf, line) + borderwidth;
+				if (emphasis && src[row] == XBuf + (line << 8) + borderwidth)
+					dsrc[row] = XDBuf + (line << 8) + borderwidth;
+				else
+					dsrc[row] = NULL;
+			}
+
+			for (width = 0; width < 256 - (borderwidth << 1); width += 4)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					const u8 *s = src[row];
+					const u8 *d = dsrc[row];
+
+					if (d)
+					{
+						*texture++ = emph565[d[0] & 7][s[0]];
+						*texture++ = emph565[d[1] & 7][s[1]];
+						*texture++ = emph565[d[2] & 7][s[2]];
+						*texture++ = emph565[d[3] & 7][s[3]];
+						dsrc[row] = d + 4;
+					}
+					else
+					{
+						*texture++ = rgb565[s[0]];
+						*texture++ = rgb565[s[1]];
+						*texture++ = rgb565[s[2]];
+						*texture++ = rgb565[s[3]];
+					}
+					src[row] = s + 4;
+				}
+			}
+			texture += (borderwidth << 3);
 		}
-		src1 += 768 + (borderwidth << 1); // line 4*N
-		src2 += 768 + (borderwidth << 1); // line 4*(N+1)
-		src3 += 768 + (borderwidth << 1); // line 4*(N+2)
-		src4 += 768 + (borderwidth << 1); // line 4*(N+3)
+		videoTimings.scale = diff_usec(stagestart, gettime());
 
-		texture += (borderwidth << 3);
+		// load texture into GX
+		stagestart = gettime();
+		DCFlushRange(texturemem, TEXTUREMEM_SIZE);
+		GX_LoadTexObj(&texobj, GX_TEXMAP0);
 	}
 
-	// load texture into GX
-	DCFlushRange(texturemem, TEXTUREMEM_SIZE);
-
 	// clear texture objects
 	GX_InvalidateTexAll();
 
 	// render textured quad
 	draw_square(view);
 	GX_DrawDone();
+	videoTimings.blit = diff_usec(stagestart, gettime());
 
 	if(ScreenshotRequested)
 	{
@@ -849,18 +919,20 @@ void RenderStereoFrames(unsigned char *XBufLeft, unsigned char *XBufRight)
 		borderwidth = 8;
 
 	u16 *texture = (unsigned short *)texturemem + (borderheight << 8) + (borderwidth << 2);
-	u8 *Lsrc1 = XBufLeft + (borderheight << 8) + borderwidth;
-	u8 *Lsrc2 = XBufLeft + (borderheight << 8) + borderwidth + 256;
-	u8 *Lsrc3 = XBufLeft + (borderheight << 8) + borderwidth + 512;
-	u8 *Lsrc4 = XBufLeft + (borderheight << 8) + borderwidth + 768;
-	u8 *Rsrc1 = XBufRight + (borderheight << 8) + borderwidth;
-	u8 *Rsrc2 = XBufRight + (borderheight << 8) + borderwidth + 256;
-	u8 *Rsrc3 = XBufRight + (borderheight << 8) + borderwidth + 512;
-	u8 *Rsrc4 = XBufRight + (borderheight << 8) + borderwidth + 768;
 
 	// fill the texture with red/cyan anaglyph
 	for (height = 0; height < 240 - (borderheight << 1); height += 4)
 	{
+		// HUD overlay lines replace the emulator output where present
+		const u8 *Lsrc1 = FCEU_OverlayLine(XBufLeft, borderheight + height) + borderwidth;
+		const u8 *Lsrc2 = FCEU_OverlayLine(XBufLeft, borderheight + height + 1) + borderwidth;
+		const u8 *Lsrc3 = FCEU_OverlayLine(XBufLeft, borderheight + height + 2) + borderwidth;
+		const u8 *Lsrc4 = FCEU_OverlayLine(XBufLeft, borderheight + height + 3) + borderwidth;
+		const u8 *Rsrc1 = FCEU_OverlayLine(XBufRight, borderheight + height) + borderwidth;
+		const u8 *Rsrc2 = FCEU_OverlayLine(XBufRight, borderheight + height + 1) + borderwidth;
+		const u8 *Rsrc3 = FCEU_OverlayLine(XBufRight, borderheight + height + 2) + borderwidth;
+		const u8 *Rsrc4 = FCEU_OverlayLine(XBufRight, borderheight + height + 3) + borderwidth;
+
 		for (width = 0; width < 256 - (borderwidth << 1); width += 4)
 		{
 			// Row one
@@ -884,20 +956,12 @@ void RenderStereoFrames(unsigned char *XBufLeft, unsigned char *XBufRight)
 			*texture++ = anaglyph565[(*Lsrc4++) & 63][(*Rsrc4++) & 63];
 			*texture++ = anaglyph565[(*Lsrc4++) & 63][(*Rsrc4++) & 63];
 		}
-		Lsrc1 += 768 + (borderwidth << 1); // line 4*N
-		Lsrc2 += 768 + (borderwidth << 1); // line 4*(N+1)
-		Lsrc3 += 768 + (borderwidth << 1); // line 4*(N+2)
-		Lsrc4 += 768 + (borderwidth << 1); // line 4*(N+3)
-		Rsrc1 += 768 + (borderwidth << 1); // line 4*N
-		Rsrc2 += 768 + (borderwidth << 1); // line 4*(N+1)
-		Rsrc3 += 768 + (borderwidth << 1); // line 4*(N+2)
-		Rsrc4 += 768 + (borderwidth << 1); // line 4*(N+3)
-
 		texture += (borderwidth << 3);
 	}
 
 	// load texture into GX
 	DCFlushRange(texturemem, TEXTUREMEM_SIZE);
+	GX_LoadTexObj(&texobj, GX_TEXMAP0); // stereo frames are never upscaled
 
 	// clear texture objects
 	GX_InvalidateTexAll();
@@ -1218,7 +1282,9 @@ static void GenerateAnaglyphPalette()
 		for (int right = 0; right < 64; right++)
 		{
 			u8 ar, ag, ab;
-			OptimisedAnaglyph(&ar, &ag, &ab, pcpalette[left].r, pcpalette[left].g, pcpalette[left].b, pcpalette[right].r, pcpalette[right].g, pcpalette[right].b);
+			const pcpal *l = &pcpalette[0x80 | left]; // colours without emphasis
+			const pcpal *r = &pcpalette[0x80 | right];
+			OptimisedAnaglyph(&ar, &ag, &ab, l->r, l->g, l->b, r->r, r->g, r->b);
 			anaglyph565[left][right] = ((ar & 0xf8) << 8) | ((ag & 0xfc) << 3) | ((ab & 0xf8) >> 3);
 		}
 	}
@@ -1283,28 +1349,53 @@ void FCEUD_GetPalette(u8 i, u8 *r, u8 *g, u8 *b)
     *b = pcpalette[i].b;
 }
 
+/****************************************************************************
+ * SetEmphasisPalette
+ *
+ * Builds the texture palette for each emphasis setting from the 512 colour
+ * palette, so the blit can look up XBuf and XDBuf directly. Entries below
+ * 0x40 are the emulator's own colours and don't take emphasis.
+ ****************************************************************************/
+void FCEUD_SetEmphasisPalette(const u8 *rgb)
+{
+	for (int e = 0; e < 8; e++)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			if (i < 0x40)
+			{
+				emph565[e][i] = rgb565[i];
+				continue;
+			}
+
+			const u8 *c = rgb + (((e << 6) | (i & 0x3f)) * 3);
+			emph565[e][i] = ((c[0] & 0xf8) << 8) |
+				((c[1] & 0xfc) << 3) |
+				((c[2] & 0xf8) >> 3);
+		}
+	}
+	emph565Valid = true;
+}
+
 void SetPalette()
 {
 	if (GCSettings.currpal == 0 || (GameInfo->type == GIT_VSUNI))
 	{
 		// Do palette reset
-		FCEU_ResetPalette();
+		FCEUI_SetUserPalette(NULL, 0);
 	}
 	else
 	{
-		// Now setup this palette
-		u8 i,r,g,b;
+		// Now setup this palette - the emulator generates the emphasis variants
+		u8 pal[64 * 3];
 
-		for ( i = 0; i < 64; i++ )
+		for (int i = 0; i < 64; i++)
 		{
-			r = palettes[GCSettings.currpal-1].data[i] >> 16;
-			g = ( palettes[GCSettings.currpal-1].data[i] & 0xff00 ) >> 8;
-			b = ( palettes[GCSettings.currpal-1].data[i] & 0xff );
-			FCEUD_SetPalette( i, r, g, b);
-			FCEUD_SetPalette( i+64, r, g, b);
-			FCEUD_SetPalette( i+128, r, g, b);
-			FCEUD_SetPalette( i+192, r, g, b);
+			pal[i*3] = palettes[GCSettings.currpal-1].data[i] >> 16;
+			pal[i*3+1] = ( palettes[GCSettings.currpal-1].data[i] & 0xff00 ) >> 8;
+			pal[i*3+2] = ( palettes[GCSettings.currpal-1].data[i] & 0xff );
 		}
+		FCEUI_SetUserPalette(pal, 64);
 	}
 }
 
@@ -21,6 +21,13 @@ struct st_palettes {
     unsigned int data[64];
 };
 
+// per-stage frame timings (microseconds) for the last frame
+struct st_videotimings {
+	u32 emulate;	// FCEUI_Emulate
+	u32 scale;		// scaling / palette conversion into the texture
+	u32 blit;		// texture flush and GX draw
+};
+
 void InitGCVideo ();
 void StopGX();
 void ResetVideo_Emu ();
@@ -50,5 +57,6 @@ extern u32 FrameTimer;
 extern bool shutter_3d_mode;
 extern bool anaglyph_3d_mode;
 extern bool eye_3d;
+extern struct st_videotimings videoTimings;
 
 #endif
@@ -27,6 +27,14 @@
 #include "fceusupport.h"
 #include "pad.h"
 #include "gcvideo.h"
+#include "scaler.h"
+#include "pngwriter.h"
+#include "statewriter.h"
+#include "statestore.h"
+#include "statebench.h"
+#include "recorder.h"
+#include "rewind.h"
+#include "nsfrender.h"
 #include "filebrowser.h"
 #include "gcunzip.h"
 #include "fileop.h"
@@ -1470,7 +1478,10 @@ static int MenuGame()
 	resetBtn.SetTrigger(trig2);
 	resetBtn.SetEffectGrow();
 
-	GuiText screenshotBtnTxt("Screenshot", 22, (GXColor){0, 0, 0, 255});
+	bool nsf = GameInfo && GameInfo->type == GIT_NSF;
+
+	GuiText screenshotBtnTxt(nsf ? "Render Tracks" : "Screenshot", 22, (GXColor){0, 0, 0, 255});
+	screenshotBtnTxt.SetWrap(true, btnLargeOutline.GetWidth()-30);
 	GuiImage screenshotBtnImg(&btnLargeOutline);
 	GuiImage screenshotBtnImgOver(&btnLargeOutlineOver);
 	GuiImage screenshotBtnIcon(&iconScreenshot);
@@ -1698,6 +1709,22 @@ static int MenuGame()
 				menu = MENU_EXIT;
 			}
 		}
+		else if(screenshotBtn.GetState() == STATE_CLICKED && nsf)
+		{
+			if (WindowPrompt("Render Tracks", "Render every track to a WAV file in the screenshots folder? Playback will restart.", "OK", "Cancel"))
+			{
+				int written = NSFRenderTracks();
+
+				if(written < 0)
+					ErrorPrompt("Unable to render tracks!");
+				else
+				{
+					char msg[64];
+					snprintf(msg, 64, "%d track(s) rendered.", written);
+					InfoPrompt(msg);
+				}
+			}
+		}
 		else if(screenshotBtn.GetState() == STATE_CLICKED)
 		{
 			if (WindowPrompt("Preview Screenshot", "Save a new Preview Screenshot? Current Screenshot image will be overwritten.", "OK", "Cancel"))
@@ -1919,6 +1946,7 @@ static int MenuGameSaves(int action)
 	memset(&saves, 0, sizeof(saves));
 
 	sprintf(browser.dir, "%s%s", pathPrefix[GCSettings.SaveMethod], GCSettings.SaveFolder);
+	WaitStateWriter(); // list states that are still being written
 	ParseDirectory(true, false);
 
 	len = strlen(romFilename);
@@ -1953,6 +1981,7 @@ static int MenuGameSaves(int action)
 			if(saves.type[j] == FILE_STATE)
 			{
 				sprintf(scrfile, "%s%s/%s.png", pathPrefix[GCSettings.SaveMethod], GCSettings.SaveFolder, tmp);
+				WaitPngWriter(); // preview may still be being written
 
 				memset(savebuffer, 0, SAVEBUFFERSIZE);
 				if(LoadFile(scrfile, SILENT))
@@ -2040,6 +2069,8 @@ static int MenuGameSaves(int action)
 							deletepath[strlen(deletepath)-4] = 0;
 							strcat(deletepath, ".fcs");
 							remove(deletepath); // Delete the *.fcs file (Save State file)
+							GetStoreFolder(deletepath, filepath, romFilename);
+							StoreCompact(deletepath); // Delete the stored blocks only it used
 						break;
 					}							
 				}
@@ -2532,7 +2563,8 @@ static int MenuSettingsMappings()
 	zapperBtn.SetTrigger(trig2);
 	zapperBtn.SetEffectGrow();
 
-	GuiText fastforwardBtnTxt("Fast Forward", 22, (GXColor){0, 0, 0, 255});
+	GuiText fastforwardBtnTxt("Fast Forward & Rewind", 22, (GXColor){0, 0, 0, 255});
+	fastforwardBtnTxt.SetWrap(true, btnLargeOutline.GetWidth()-65);
 	GuiImage fastforwardBtnImg(&btnLargeOutline);
 	GuiImage fastforwardBtnImgOver(&btnLargeOutlineOver);
 	GuiImage fastforwardBtnIcon(&iconFastForward);
@@ -3458,6 +3490,29 @@ static void ScreenPositionWindow()
 	delete(settingText);
 }
 
+static const char * HotkeyName(int button)
+{
+	switch(button)
+	{
+		case 0: return "Right Stick";
+		case 1: return "A";
+		case 2: return "B";
+		case 3: return "X";
+		case 4: return "Y";
+		case 5: return "L";
+		case 6: return "R";
+		case 7: return "ZL";
+		case 8: return "ZR";
+		case 9: return "Z";
+		case 10: return "C";
+		case 11: return "1";
+		case 12: return "2";
+		case 13: return "PLUS";
+		case 14: return "MINUS";
+	}
+	return "";
+}
+
 static int MenuSettingsFastForward()
 {
 	int menu = MENU_NONE;
@@ -3468,6 +3523,8 @@ static int MenuSettingsFastForward()
 
 	sprintf(options.name[i++], "Fast Forward");
 	sprintf(options.name[i++], "Button");
+	sprintf(options.name[i++], "Rewind");
+	sprintf(options.name[i++], "Rewind Button");
 	options.length = i;
 
 	for(i=0; i < options.length; i++)
@@ -3477,10 +3534,21 @@ static int MenuSettingsFastForward()
 	titleTxt.SetAlignment(ALIGN_LEFT, ALIGN_TOP);
 	titleTxt.SetPosition(50,30);
 
-	GuiText subtitleTxt("Fast Forward", 20, (GXColor){255, 255, 255, 255});
+	GuiText subtitleTxt("Fast Forward & Rewind", 20, (GXColor){255, 255, 255, 255});
 	subtitleTxt.SetAlignment(ALIGN_LEFT, ALIGN_TOP);
 	subtitleTxt.SetPosition(50,60);
 
+	// history held for the current game, and what capturing it costs
+	char rewindInfo[100] = { 0 };
+	if(rewindStats.snapshots)
+		sprintf(rewindInfo, "Rewind: %u frames (%u KB), capture %.2f ms (max %.2f ms)",
+			(unsigned)rewindStats.snapshots, (unsigned)(rewindStats.used >> 10),
+			rewindStats.capture / 1000.0f, rewindStats.capturemax / 1000.0f);
+
+	GuiText rewindTxt(rewindInfo, 16, (GXColor){255, 255, 255, 255});
+	rewindTxt.SetAlignment(ALIGN_RIGHT, ALIGN_BOTTOM);
+	rewindTxt.SetPosition(-50,-100);
+
 	GuiSound btnSoundOver(button_over_pcm, button_over_pcm_size, SOUND_PCM);
 	GuiSound btnSoundClick(button_click_pcm, button_click_pcm_size, SOUND_PCM);
 	GuiImageData btnOutline(button_png);
@@ -3520,6 +3588,7 @@ static int MenuSettingsFastForward()
 	mainWindow->Append(&w);
 	mainWindow->Append(&titleTxt);
 	w.Append(&subtitleTxt);
+	w.Append(&rewindTxt);
 	ResumeGui();
 
 	while(menu == MENU_NONE)
@@ -3539,46 +3608,29 @@ static int MenuSettingsFastForward()
 				if (GCSettings.FastForwardButton > 14)
 					GCSettings.FastForwardButton = 0;
 				break;
+
+			case 2:
+				GCSettings.Rewind ^= 1;
+				break;
+
+			case 3:
+				GCSettings.RewindButton++;
+				if (GCSettings.RewindButton > 14)
+					GCSettings.RewindButton = 0;
+				break;
 		}
 
 		if(ret >= 0 || firstRun)
 		{
 			firstRun = false;
 			sprintf (options.value[0], "%s", GCSettings.FastForward == 1 ? "On" : "Off");
+			sprintf (options.value[1], "%s", HotkeyName(GCSettings.FastForwardButton));
+			sprintf (options.value[2], "%s", GCSettings.Rewind == 1 ? "On" : "Off");
 
-			switch(GCSettings.FastForwardButton)
-			{
-				case 0:
-					sprintf (options.value[1], "Right Stick"); break;
-				case 1:
-					sprintf (options.value[1], "A"); break;
-				case 2:
-					sprintf (options.value[1], "B"); break;
-				case 3:
-					sprintf (options.value[1], "X"); break;
-				case 4:
-					sprintf (options.value[1], "Y"); break;
-				case 5:
-					sprintf (options.value[1], "L"); break;
-				case 6:
-					sprintf (options.value[1], "R"); break;
-				case 7:
-					sprintf (options.value[1], "ZL"); break;
-				case 8:
-					sprintf (options.value[1], "ZR"); break;
-				case 9:
-					sprintf (options.value[1], "Z"); break;
-				case 10:
-					sprintf (options.value[1], "C"); break;
-				case 11:
-					sprintf (options.value[1], "1"); break;
-				case 12:
-					sprintf (options.value[1], "2"); break;
-				case 13:
-					sprintf (options.value[1], "PLUS"); break;
-				case 14:
-					sprintf (options.value[1], "MINUS"); break;
-			}
+			if(GCSettings.RewindButton == 0)
+				sprintf (options.value[3], "Right Stick Left");
+			else
+				sprintf (options.value[3], "%s", HotkeyName(GCSettings.RewindButton));
 
 			optionBrowser.TriggerUpdate();
 		}
@@ -3615,6 +3667,9 @@ static int MenuSettingsVideo()
 	sprintf(options.name[i++], "NTSC Color");
 	sprintf(options.name[i++], "Show Crosshair");
 	sprintf(options.name[i++], "Region");
+	sprintf(options.name[i++], "Scaling Filter");
+	sprintf(options.name[i++], "Record Video");
+	sprintf(options.name[i++], "Recording Backlog");
 
 	options.length = i;
 
@@ -3625,6 +3680,17 @@ static int MenuSettingsVideo()
 	titleTxt.SetAlignment(ALIGN_LEFT, ALIGN_TOP);
 	titleTxt.SetPosition(50,50);
 
+	// stage timings of the last frame shown before the menu opened
+	char timingInfo[100] = { 0 };
+	if(videoTimings.emulate)
+		sprintf(timingInfo, "Last frame: emulate %.2f ms, scale %.2f ms, blit %.2f ms",
+			videoTimings.emulate / 1000.0f, videoTimings.scale / 1000.0f,
+			videoTimings.blit / 1000.0f);
+
+	GuiText timingTxt(timingInfo, 16, (GXColor){255, 255, 255, 255});
+	timingTxt.SetAlignment(ALIGN_RIGHT, ALIGN_BOTTOM);
+	timingTxt.SetPosition(-50,-100);
+
 	GuiSound btnSoundOver(button_over_pcm, button_over_pcm_size, SOUND_PCM);
 	GuiSound btnSoundClick(button_click_pcm, button_click_pcm_size, SOUND_PCM);
 	GuiImageData btnOutline(button_png);
@@ -3663,6 +3729,7 @@ static int MenuSettingsVideo()
 	mainWindow->Append(&optionBrowser);
 	mainWindow->Append(&w);
 	mainWindow->Append(&titleTxt);
+	w.Append(&timingTxt);
 	ResumeGui();
 
 	while(menu == MENU_NONE)
@@ -3723,6 +3790,22 @@ static int MenuSettingsVideo()
 				if(GCSettings.region > 2)
 					GCSettings.region = 0;
 				break;
+
+			case 11:
+				GCSettings.scaler++;
+				if(GCSettings.scaler >= SCALER_COUNT)
+					GCSettings.scaler = 0;
+				break;
+
+			case 12:
+				GCSettings.recording++;
+				if(GCSettings.recording >= RECORD_COUNT)
+					GCSettings.recording = 0;
+				break;
+
+			case 13:
+				GCSettings.recordpolicy ^= 1;
+				break;
 		}
 
 		if(ret >= 0 || firstRun)
@@ -3785,6 +3868,10 @@ static int MenuSettingsVideo()
 				case 2:
 					sprintf (options.value[10], "Automatic"); break;
 			}
+
+			sprintf (options.value[11], "%s", ScalerName(GCSettings.scaler));
+			sprintf (options.value[12], "%s", RecorderFormatName(GCSettings.recording));
+			sprintf (options.value[13], "%s", GCSettings.recordpolicy == RECORD_THROTTLE ? "Slow Emulation" : "Drop Frames");
 			optionBrowser.TriggerUpdate();
 		}
 
@@ -3815,6 +3902,7 @@ static int MenuSettingsAudio()
 	sprintf(options.name[i++], "Sound Quality");
 	sprintf(options.name[i++], "Low Pass Filter");
 	sprintf(options.name[i++], "Swap Duty Cycles");
+	sprintf(options.name[i++], "Dynamic Rate Control");
 
 	options.length = i;
 
@@ -3881,7 +3969,7 @@ static int MenuSettingsAudio()
 
 			case 1:
 				GCSettings.soundquality++;
-				if (GCSettings.soundquality > 2)
+				if (GCSettings.soundquality > 3)
 					GCSettings.soundquality = 0;
 				break;
 
@@ -3892,6 +3980,10 @@ static int MenuSettingsAudio()
 			case 3:
 				GCSettings.swapduty ^= 1;
 				break;
+
+			case 4:
+				GCSettings.ratecontrol ^= 1;
+				break;
 		}
 
 		if(ret >= 0 || firstRun)
@@ -3911,10 +4003,13 @@ static int MenuSettingsAudio()
 					sprintf (options.value[1], "High"); break;
 				case 2:
 					sprintf (options.value[1], "Very High"); break;
+				case 3:
+					sprintf (options.value[1], "Band-limited"); break;
 			}
 
 			sprintf (options.value[2], "%s", GCSettings.lowpass == 1 ? "On" : "Off");
 			sprintf (options.value[3], "%s", GCSettings.swapduty == 1 ? "On" : "Off");
+			sprintf (options.value[4], "%s", GCSettings.ratecontrol == 1 ? "On" : "Off");
 
 			optionBrowser.TriggerUpdate();
 		}
@@ -4279,6 +4374,8 @@ static int MenuSettingsFile()
 	sprintf(options.name[i++], "Artwork Folder");
 	sprintf(options.name[i++], "Auto Load");
 	sprintf(options.name[i++], "Auto Save");
+	sprintf(options.name[i++], "State Store");
+	sprintf(options.name[i++], "Benchmark Savestates");
 	options.length = i;
 
 	for(i=0; i < options.length; i++)
@@ -4379,6 +4476,31 @@ static int MenuSettingsFile()
 				if (GCSettings.AutoSave > 3)
 					GCSettings.AutoSave = 0;
 				break;
+
+			case 10:
+				GCSettings.StateStore ^= 1;
+				break;
+
+			case 11:
+				if(browser.dir[0] == 0)
+				{
+					ErrorPrompt("Browse to a folder of games first!");
+				}
+				else if (WindowPrompt("Benchmark Savestates", "Time savestates of every game in the last browsed folder, and write the results to statebench.csv in the save folder? The current game will be closed.", "OK", "Cancel"))
+				{
+					int roms = StateBenchmark(browser.dir);
+
+					if(roms < 0)
+						ErrorPrompt("Unable to run the benchmark!");
+					else
+					{
+						char msg[64];
+						snprintf(msg, 64, "%d game(s) benchmarked.", roms);
+						InfoPrompt(msg);
+					}
+					menu = MENU_GAMESELECTION;
+				}
+				break;
 		}
 
 		if(ret >= 0 || firstRun)
@@ -4457,6 +4579,8 @@ static int MenuSettingsFile()
 			else if (GCSettings.AutoSave == 2) sprintf (options.value[9],"State");
 			else if (GCSettings.AutoSave == 3) sprintf (options.value[9],"Both");
 
+			sprintf (options.value[10], "%s", GCSettings.StateStore == 1 ? "Deduplicated" : "Files");
+
 			optionBrowser.TriggerUpdate();
 		}
 
@@ -0,0 +1,139 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * nsfrender.cpp
+ *
+ * Offline rendering of NSF tracks to WAV
+ *
+ * Each track of the loaded NSF is played from power on as fast as the
+ * emulator runs - no video or audio output and no frame timing - and logged
+ * through the core's wave writer to <rom>-<track>.wav in the screenshots
+ * folder. A track ends after NSFRENDER_SILENCE seconds of silence once it
+ * has been heard, or after NSFRENDER_MAXLENGTH seconds.
+ *
+ * The core keeps its state in globals and the Broadway/Gekko CPU has a
+ * single core, so the tracks are rendered one after another on the calling
+ * thread.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fceuxtx.h"
+#include "fceusupport.h"
+#include "filebrowser.h"
+#include "fileop.h"
+#include "menu.h"
+#include "nsfrender.h"
+#include "fceux/wave.h"
+
+#define SILENCE_LEVEL 16 // largest sample still counted as silence
+
+static bool IsSilent(const int32 *sound, int count)
+{
+	for(int i = 0; i < count; i++)
+		if(sound[i] > SILENCE_LEVEL || sound[i] < -SILENCE_LEVEL)
+			return false;
+	return true;
+}
+
+/****************************************************************************
+ * RenderTrack
+ *
+ * Returns false if the WAV file could not be created or written
+ ***************************************************************************/
+static bool RenderTrack(int track, int tracks, const char *filepath)
+{
+	uint8 *gfx;
+	int32 *sound;
+	int32 ssize;
+	char msg[64];
+	u32 rate = FSettings.SndRate;
+	u32 maxlength = rate * NSFRENDER_MAXLENGTH;
+	u32 samples = 0;
+	u32 silent = 0;
+	bool heard = false;
+	int frames = 0;
+
+	PowerNES();
+	FCEUI_NSFChange(track - FCEUI_NSFChange(0));
+
+	if(!FCEUI_BeginWaveRecord(filepath))
+		return false;
+
+	snprintf(msg, 64, "Rendering track %d of %d...", track, tracks);
+
+	while(samples < maxlength)
+	{
+		FCEUI_Emulate(&gfx, &sound, &ssize, 1); // skip video, keep sound
+		samples += ssize;
+
+		if(!FCEUI_WaveRecordRunning())
+			return false; // a write failed and ended the log
+
+		if(IsSilent(sound, ssize))
+		{
+			silent += ssize;
+		}
+		else
+		{
+			heard = true;
+			silent = 0;
+		}
+
+		if(silent >= rate * (heard ? NSFRENDER_SILENCE : NSFRENDER_LEADIN))
+			break;
+
+		if((++frames & 31) == 0)
+			ShowProgress(msg, samples, maxlength);
+	}
+
+	FCEUI_EndWaveRecord();
+	return true;
+}
+
+/****************************************************************************
+ * NSFRenderTracks
+ *
+ * Renders every track of the loaded NSF. Returns the number of tracks
+ * written, or -1 if no NSF is loaded or the save device is unavailable.
+ * Playback restarts from power on afterwards.
+ ***************************************************************************/
+int NSFRenderTracks()
+{
+	char filepath[1024];
+	uint8 name[32], artist[32], copyright[32];
+	int written = 0;
+	int32 rateadjust;
+
+	if(!GameInfo || GameInfo->type != GIT_NSF || !FSettings.SndRate)
+		return -1;
+
+	if(!ChangeInterface(GCSettings.SaveMethod, NOTSILENT))
+		return -1;
+
+	int tracks = FCEUI_NSFGetInfo(name, artist, copyright, 32);
+
+	// the driver's rate control would stretch the files, render at the exact rate
+	rateadjust = FCEUI_GetSoundRateAdjust();
+	FCEUI_SetSoundRateAdjust(0);
+
+	for(int track = 1; track <= tracks; track++)
+	{
+		snprintf(filepath, 1024, "%s%s/%s-%02d.wav", pathPrefix[GCSettings.SaveMethod], GCSettings.ScreenshotsFolder, romFilename, track);
+
+		if(!RenderTrack(track, tracks, filepath))
+			break;
+
+		written++;
+	}
+
+	FCEUI_SetSoundRateAdjust(rateadjust);
+	CancelAction();
+	PowerNES();
+	return written;
+}
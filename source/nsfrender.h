@@ -0,0 +1,21 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * nsfrender.h
+ *
+ * Offline rendering of NSF tracks to WAV
+ ****************************************************************************/
+
+#ifndef _NSFRENDER_H_
+#define _NSFRENDER_H_
+
+#define NSFRENDER_MAXLENGTH 300	// seconds, longest a track is rendered for
+#define NSFRENDER_SILENCE 3		// seconds of silence that end a track
+#define NSFRENDER_LEADIN 10		// seconds a track may stay silent at the start
+
+int NSFRenderTracks();
+
+#endif
@@ -674,15 +674,21 @@ bool MenuRequested()
 	return false;
 }
 
-bool IsFastForwardInputPressed()
+/****************************************************************************
+ * IsHotkeyPressed
+ *
+ * button is one of FASTFORWARD_BUTTON_*. The right stick counts when pushed
+ * in the direction of stickdir (1 = right, -1 = left).
+ ***************************************************************************/
+static bool IsHotkeyPressed(int button, int stickdir)
 {
-	switch(GCSettings.FastForwardButton)
+	switch(button)
 	{
 		case FASTFORWARD_BUTTON_RSTICK:
 			return (
-				userInput[0].pad.substickX > 70 ||
-				userInput[0].WPAD_StickX(1) > 70 ||
-				userInput[0].wiidrcdata.substickX > 45);
+				userInput[0].pad.substickX * stickdir > 70 ||
+				userInput[0].WPAD_StickX(1) * stickdir > 70 ||
+				userInput[0].wiidrcdata.substickX * stickdir > 45);
 		case FASTFORWARD_BUTTON_A:
 			return (
 				userInput[0].wpad->btns_h & WPAD_CLASSIC_BUTTON_A ||
@@ -753,6 +759,16 @@ bool IsFastForwardInputPressed()
 	}
 }
 
+bool IsFastForwardInputPressed()
+{
+	return IsHotkeyPressed(GCSettings.FastForwardButton, 1);
+}
+
+bool IsRewindInputPressed()
+{
+	return IsHotkeyPressed(GCSettings.RewindButton, -1);
+}
+
 void GetJoy()
 {
 	JSReturn = 0; // reset buttons pressed
@@ -766,6 +782,11 @@ void GetJoy()
 		fastforward = IsFastForwardInputPressed();
 	}
 
+	if (GCSettings.Rewind == 1)
+	{
+		rewinding = IsRewindInputPressed();
+	}
+
 	// request to go back to menu
 	if(MenuRequested())
 		ScreenshotRequested = 1; // go to the menu
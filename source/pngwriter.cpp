@@ -0,0 +1,250 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * pngwriter.cpp
+ *
+ * Background PNG encoding and writing of emulator frames
+ *
+ * The caller's 256x240 indexed frame and the current palette are copied
+ * into a job, which a low priority thread compresses into an 8-bit
+ * paletted PNG and writes out. One job can be in progress while another
+ * waits; queueing blocks only if both slots are taken.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "fceuxtx.h"
+#include "fceusupport.h"
+#include "fileop.h"
+#include "pngwriter.h"
+
+#define THREAD_SLEEP 100
+
+#define PNG_WIDTH 256
+#define PNG_HEIGHT 240
+#define PNG_ROWSIZE (PNG_WIDTH + 1) // filter type byte + indices
+#define PNG_RAWSIZE (PNG_ROWSIZE * PNG_HEIGHT)
+// signature + IHDR + PLTE + IDAT headers + IEND
+#define PNG_OVERHEAD (8 + 25 + (12 + 256*3) + 12 + 12)
+
+typedef struct {
+	u8 frame[PNG_WIDTH * PNG_HEIGHT];
+	u8 palette[256 * 3];
+	char filepath[1024];
+	int mode;
+	pngwritecallback callback;
+} pngjob;
+
+static lwp_t pngthread = LWP_THREAD_NULL;
+static u8 pngstack[32768] ATTRIBUTE_ALIGN (8);
+static mutex_t pngLock = LWP_MUTEX_NULL;
+static cond_t pngCond = LWP_COND_NULL;
+
+static pngjob pending;
+static pngjob active;
+static volatile bool jobPending = false;
+static volatile bool jobActive = false;
+
+static u8 rawbuffer[PNG_RAWSIZE];
+static u8 pngbuffer[PNG_OVERHEAD + PNG_RAWSIZE + PNG_RAWSIZE / 1000 + 64];
+
+static u8 * PutChunk(u8 *dst, const char *type, const u8 *data, u32 size)
+{
+	dst[0] = size >> 24;
+	dst[1] = size >> 16;
+	dst[2] = size >> 8;
+	dst[3] = size;
+	memcpy(dst + 4, type, 4);
+
+	if(size && data != dst + 8)
+		memcpy(dst + 8, data, size);
+
+	u32 crc = crc32(0, dst + 4, size + 4);
+	dst += 8 + size;
+	dst[0] = crc >> 24;
+	dst[1] = crc >> 16;
+	dst[2] = crc >> 8;
+	dst[3] = crc;
+	return dst + 4;
+}
+
+/****************************************************************************
+ * EncodePng
+ *
+ * Builds a complete PNG file in pngbuffer, returns its size (0 on error)
+ ***************************************************************************/
+static int EncodePng(const pngjob *job)
+{
+	static const u8 signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	u8 ihdr[13];
+	u8 *dst = pngbuffer;
+
+	memcpy(dst, signature, 8);
+	dst += 8;
+
+	ihdr[0] = ihdr[1] = 0;
+	ihdr[2] = PNG_WIDTH >> 8;
+	ihdr[3] = PNG_WIDTH & 0xff;
+	ihdr[4] = ihdr[5] = 0;
+	ihdr[6] = PNG_HEIGHT >> 8;
+	ihdr[7] = PNG_HEIGHT & 0xff;
+	ihdr[8] = 8;	// bit depth
+	ihdr[9] = 3;	// color type: indexed
+	ihdr[10] = 0;	// compression: deflate
+	ihdr[11] = 0;	// filter set
+	ihdr[12] = 0;	// no interlace
+	dst = PutChunk(dst, "IHDR", ihdr, 13);
+	dst = PutChunk(dst, "PLTE", job->palette, 256 * 3);
+
+	const u8 *src = job->frame;
+	u8 *raw = rawbuffer;
+
+	for(int y = 0; y < PNG_HEIGHT; y++)
+	{
+		*raw++ = 0; // no filter
+		memcpy(raw, src, PNG_WIDTH);
+		raw += PNG_WIDTH;
+		src += PNG_WIDTH;
+	}
+
+	// compress straight into the IDAT chunk
+	uLongf complen = sizeof(pngbuffer) - (dst - pngbuffer) - 8 - 4 - 12;
+
+	if(compress2(dst + 8, &complen, rawbuffer, PNG_RAWSIZE, Z_BEST_SPEED) != Z_OK)
+		return 0;
+
+	dst = PutChunk(dst, "IDAT", dst + 8, complen);
+	dst = PutChunk(dst, "IEND", NULL, 0);
+	return dst - pngbuffer;
+}
+
+/****************************************************************************
+ * WritePng
+ ***************************************************************************/
+static bool WritePng(pngjob *job)
+{
+	int size = EncodePng(job);
+
+	if(size == 0)
+		return false;
+
+	if(job->mode == PNGWRITE_NUMBERED)
+	{
+		struct stat st;
+		char base[1024];
+		strncpy(base, job->filepath, 1000);
+		base[1000] = 0;
+
+		for(int u = 0; u < 99999; u++)
+		{
+			snprintf(job->filepath, 1024, "%s-%d.png", base, u);
+			if(stat(job->filepath, &st) != 0)
+				break;
+		}
+	}
+
+	// not the shared fileop handle - we may run alongside a SaveFile
+	FILE *fp = fopen(job->filepath, "wb");
+
+	if(!fp)
+		return false;
+
+	int written = fwrite(pngbuffer, 1, size, fp);
+	fclose(fp);
+	return written == size;
+}
+
+/****************************************************************************
+ * pngcallback
+ *
+ * Writer thread - sleeps until a job is queued
+ ***************************************************************************/
+static void *
+pngcallback (void *arg)
+{
+	while(1)
+	{
+		LWP_MutexLock(pngLock);
+		while(!jobPending)
+			LWP_CondWait(pngCond, pngLock);
+		memcpy(&active, &pending, sizeof(pngjob));
+		jobActive = true;
+		jobPending = false;
+		LWP_MutexUnlock(pngLock);
+
+		HoldDeviceThread(); // no device checks while writing
+		bool success = WritePng(&active);
+		ReleaseDeviceThread();
+
+		if(active.callback)
+			active.callback(active.filepath, success);
+
+		jobActive = false;
+	}
+	return NULL;
+}
+
+void InitPngWriter()
+{
+	LWP_MutexInit(&pngLock, false);
+	LWP_CondInit(&pngCond);
+	LWP_CreateThread (&pngthread, pngcallback, NULL, pngstack, sizeof(pngstack), 40);
+}
+
+/****************************************************************************
+ * QueuePngWrite
+ *
+ * Copies frame (256x240 palette indices) and the current palette, and
+ * returns immediately. The device holding filepath is mounted here, on the
+ * caller's thread.
+ ***************************************************************************/
+bool QueuePngWrite(const u8 *frame, const char *filepath, int mode, pngwritecallback callback)
+{
+	int device;
+
+	if(pngthread == LWP_THREAD_NULL || !frame)
+		return false;
+
+	if(!FindDevice((char *)filepath, &device) || !ChangeInterface(device, SILENT))
+		return false;
+
+	// wait for the previous pending job to be picked up
+	while(jobPending)
+		usleep(THREAD_SLEEP);
+
+	LWP_MutexLock(pngLock);
+	memcpy(pending.frame, frame, PNG_WIDTH * PNG_HEIGHT);
+	for(int i = 0; i < 256; i++)
+		FCEUD_GetPalette(i, &pending.palette[i*3], &pending.palette[i*3+1], &pending.palette[i*3+2]);
+	snprintf(pending.filepath, 1024, "%s", filepath);
+	pending.mode = mode;
+	pending.callback = callback;
+	jobPending = true;
+	LWP_CondSignal(pngCond);
+	LWP_MutexUnlock(pngLock);
+	return true;
+}
+
+bool PngWriterBusy()
+{
+	return jobPending || jobActive;
+}
+
+/****************************************************************************
+ * WaitPngWriter
+ *
+ * Blocks until all queued PNGs have been written
+ ***************************************************************************/
+void WaitPngWriter()
+{
+	while(PngWriterBusy())
+		usleep(THREAD_SLEEP);
+}
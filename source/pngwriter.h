@@ -0,0 +1,31 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * pngwriter.h
+ *
+ * Background PNG encoding and writing of emulator frames
+ ****************************************************************************/
+
+#ifndef _PNGWRITER_H_
+#define _PNGWRITER_H_
+
+#include <gctypes.h>
+
+enum {
+	PNGWRITE_OVERWRITE,	// write to filepath as given
+	PNGWRITE_NUMBERED	// append -N.png, using the first free N
+};
+
+// called from the writer thread once the file has been written (or failed) -
+// it should only store the result, for the caller's thread to report
+typedef void (*pngwritecallback)(const char *filepath, bool success);
+
+void InitPngWriter();
+bool QueuePngWrite(const u8 *frame, const char *filepath, int mode, pngwritecallback callback);
+bool PngWriterBusy();
+void WaitPngWriter();
+
+#endif
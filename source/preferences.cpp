@@ -25,6 +25,8 @@
 #include "menu.h"
 #include "fileop.h"
 #include "gcvideo.h"
+#include "scaler.h"
+#include "recorder.h"
 #include "pad.h"
 
 struct SGCSettings GCSettings;
@@ -125,6 +127,7 @@ preparePrefsData ()
 
 	createXMLSetting("AutoLoad", "Auto Load", toStr(GCSettings.AutoLoad));
 	createXMLSetting("AutoSave", "Auto Save", toStr(GCSettings.AutoSave));
+	createXMLSetting("StateStore", "State Store", toStr(GCSettings.StateStore));
 	createXMLSetting("LoadMethod", "Load Method", toStr(GCSettings.LoadMethod));
 	createXMLSetting("SaveMethod", "Save Method", toStr(GCSettings.SaveMethod));
 	createXMLSetting("LoadFolder", "Load Folder", GCSettings.LoadFolder);
@@ -145,6 +148,9 @@ preparePrefsData ()
 	createXMLSetting("bilinear", "Bilinear Filtering", toStr(GCSettings.bilinear));
 	createXMLSetting("aspect", "Aspect Ratio", toStr(GCSettings.aspect));
 	createXMLSetting("hideoverscan", "Crop Overscan", toStr(GCSettings.hideoverscan));
+	createXMLSetting("scaler", "Scaling Filter", toStr(GCSettings.scaler));
+	createXMLSetting("recording", "Record Video", toStr(GCSettings.recording));
+	createXMLSetting("recordpolicy", "Recording Backlog", toStr(GCSettings.recordpolicy));
 	createXMLSetting("currpal", "Color Palette", toStr(GCSettings.currpal));
 	createXMLSetting("ntsccolor", "NTSC Color", toStr(GCSettings.ntsccolor));
 	createXMLSetting("crosshair", "Show Crosshair", toStr(GCSettings.crosshair));
@@ -158,6 +164,7 @@ preparePrefsData ()
 	createXMLSetting("soundquality", "Sound Quality", toStr(GCSettings.soundquality));
 	createXMLSetting("lowpass", "Low Pass Filter", toStr(GCSettings.lowpass));
 	createXMLSetting("swapduty", "Swap Duty Cycles", toStr(GCSettings.swapduty));
+	createXMLSetting("ratecontrol", "Dynamic Rate Control", toStr(GCSettings.ratecontrol));
 
 	createXMLSection("Emulation Hacks", "Emulation Hacks Settings");
 
@@ -181,6 +188,8 @@ preparePrefsData ()
 	createXMLSetting("Controller", "Controller", toStr(GCSettings.Controller));
 	createXMLSetting("FastForward", "Fast Forward", toStr(GCSettings.FastForward));
 	createXMLSetting("FastForwardButton", "Fast Forward Button", toStr(GCSettings.FastForwardButton));
+	createXMLSetting("Rewind", "Rewind", toStr(GCSettings.Rewind));
+	createXMLSetting("RewindButton", "Rewind Button", toStr(GCSettings.RewindButton));
 
 	createXMLController(btnmap[CTRL_PAD][CTRLR_GCPAD], "btnmap_pad_gcpad", "NES Pad - GameCube Controller");
 	createXMLController(btnmap[CTRL_PAD][CTRLR_WIIMOTE], "btnmap_pad_wiimote", "NES Pad - Wiimote");
@@ -303,6 +312,7 @@ decodePrefsData ()
 
 			loadXMLSetting(&GCSettings.AutoLoad, "AutoLoad");
 			loadXMLSetting(&GCSettings.AutoSave, "AutoSave");
+			loadXMLSetting(&GCSettings.StateStore, "StateStore");
 			loadXMLSetting(&GCSettings.LoadMethod, "LoadMethod");
 			loadXMLSetting(&GCSettings.SaveMethod, "SaveMethod");
 			loadXMLSetting(GCSettings.LoadFolder, "LoadFolder", sizeof(GCSettings.LoadFolder));
@@ -323,6 +333,9 @@ decodePrefsData ()
 			loadXMLSetting(&GCSettings.bilinear, "bilinear");
 			loadXMLSetting(&GCSettings.aspect, "aspect");
 			loadXMLSetting(&GCSettings.hideoverscan, "hideoverscan");
+			loadXMLSetting(&GCSettings.scaler, "scaler");
+			loadXMLSetting(&GCSettings.recording, "recording");
+			loadXMLSetting(&GCSettings.recordpolicy, "recordpolicy");
 			loadXMLSetting(&GCSettings.currpal, "currpal");
 			loadXMLSetting(&GCSettings.ntsccolor, "ntsccolor");
 			loadXMLSetting(&GCSettings.crosshair, "crosshair");
@@ -336,6 +349,7 @@ decodePrefsData ()
 			loadXMLSetting(&GCSettings.soundquality, "soundquality");
 			loadXMLSetting(&GCSettings.lowpass, "lowpass");
 			loadXMLSetting(&GCSettings.swapduty, "swapduty");
+			loadXMLSetting(&GCSettings.ratecontrol, "ratecontrol");
 
 			// Emulation Hacks Settings
 
@@ -357,6 +371,8 @@ decodePrefsData ()
 			loadXMLSetting(&GCSettings.Controller, "Controller");
 			loadXMLSetting(&GCSettings.FastForward, "FastForward");
 			loadXMLSetting(&GCSettings.FastForwardButton, "FastForwardButton");
+			loadXMLSetting(&GCSettings.Rewind, "Rewind");
+			loadXMLSetting(&GCSettings.RewindButton, "RewindButton");
 
 			loadXMLController(btnmap[CTRL_PAD][CTRLR_GCPAD], "btnmap_pad_gcpad");
 			loadXMLController(btnmap[CTRL_PAD][CTRLR_WIIMOTE], "btnmap_pad_wiimote");
@@ -402,12 +418,22 @@ void FixInvalidSettings()
 		GCSettings.Controller = CTRL_PAD2;
 	if(!(GCSettings.soundvolume >= 0 && GCSettings.soundvolume <= 150))
 		GCSettings.soundvolume = 100;
+	if(!(GCSettings.soundquality >= 0 && GCSettings.soundquality <= 3))
+		GCSettings.soundquality = 0;
 	if(!(GCSettings.videomode >= 0 && GCSettings.videomode < 6))
 		GCSettings.videomode = 0;
 	if(!(GCSettings.render >= 0 && GCSettings.render < 2))
 		GCSettings.render = 0;
 	if(GCSettings.region < 0 || GCSettings.region > 2)
 		GCSettings.region = 2;
+	if(!(GCSettings.scaler >= 0 && GCSettings.scaler < SCALER_COUNT))
+		GCSettings.scaler = 0;
+	if(!(GCSettings.recording >= 0 && GCSettings.recording < RECORD_COUNT))
+		GCSettings.recording = 0;
+	if(GCSettings.recordpolicy != RECORD_THROTTLE)
+		GCSettings.recordpolicy = RECORD_DROP;
+	if(!(GCSettings.RewindButton >= FASTFORWARD_BUTTON_RSTICK && GCSettings.RewindButton <= FASTFORWARD_BUTTON_MINUS))
+		GCSettings.RewindButton = FASTFORWARD_BUTTON_R;
 }
 
 /****************************************************************************
@@ -425,6 +451,8 @@ DefaultSettings ()
 	GCSettings.Controller = CTRL_PAD2; // NES Controllers, NES Zapper
 	GCSettings.FastForward = 1; // Enabled by default
 	GCSettings.FastForwardButton = 0; // Right analog stick
+	GCSettings.Rewind = 0; // Disabled by default
+	GCSettings.RewindButton = FASTFORWARD_BUTTON_R; // R trigger
 
 	GCSettings.gamegenie = 0; // Disabled by default
 
@@ -432,6 +460,7 @@ DefaultSettings ()
 	GCSettings.soundquality = 0; // Low sound quality
 	GCSettings.lowpass = 0; // Disabled by default
 	GCSettings.swapduty = 0; // Disabled by default
+	GCSettings.ratecontrol = 1; // Enabled by default
 
 	GCSettings.overclock = 0; // Disabled by default
 	GCSettings.nospritelimit = 0; // Disabled by default
@@ -440,6 +469,9 @@ DefaultSettings ()
 	GCSettings.render = 0; // Default rendering mode
 	GCSettings.bilinear = 0; // Disabled by default
 	GCSettings.hideoverscan = 1; // Hide vertical
+	GCSettings.scaler = 0; // Disabled by default
+	GCSettings.recording = 0; // Disabled by default
+	GCSettings.recordpolicy = 0; // Drop frames
 	GCSettings.currpal = 0; // Default color palette
 	GCSettings.ntsccolor = 0; // Disabled by default
 	GCSettings.crosshair = 1; // Enabled by default
@@ -484,6 +516,7 @@ DefaultSettings ()
 	sprintf (GCSettings.ArtworkFolder, "%s/artwork", APPFOLDER); // Path to artwork files
 	GCSettings.AutoLoad = 1; // Auto Load RAM
 	GCSettings.AutoSave = 1; // Auto Save RAM
+	GCSettings.StateStore = 0; // Whole state files
 }
 
 /****************************************************************************
@@ -0,0 +1,596 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * recorder.cpp
+ *
+ * Raw video (Y4M / indexed) and WAV capture
+ *
+ * Backs the core's AVI interface. The emulation thread copies each frame
+ * (palette indices plus the current palette) into a preallocated ring of
+ * frame slots, and mono 16-bit samples into an audio ring. Neither push
+ * allocates or touches the disk. A writer thread drains both rings. It
+ * expands frames to YUV 4:2:0 for Y4M, or writes the raw indices with
+ * palette changes for later encoding, and appends the samples to a WAV
+ * file.
+ *
+ * If the writer falls behind, frames are either dropped (the next Y4M
+ * frame is repeated to keep the timeline, and indexed frames carry their
+ * frame number) or the emulator waits for a free slot. Dropped samples
+ * are queued as gaps, which the writer fills with silence at the same
+ * point of the WAV, so it stays in step with the video.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fceuxtx.h"
+#include "fceusupport.h"
+#include "filebrowser.h"
+#include "fileop.h"
+#include "recorder.h"
+
+#define THREAD_SLEEP 100
+
+#define REC_WIDTH 256
+#define REC_HEIGHT 240
+#define REC_FRAMESIZE (REC_WIDTH * REC_HEIGHT)
+#define REC_SLOTS 8
+#define REC_AUDIOSIZE (1 << 17) // samples, must be a power of two
+#define REC_Y4MSIZE (REC_FRAMESIZE + (REC_FRAMESIZE >> 1))
+#define REC_GAPS 64 // dropped sample runs waiting to be written as silence
+
+// keep the compiler from moving ring data stores past the index update
+#define RING_BARRIER() __asm__ __volatile__ ("sync" ::: "memory")
+
+typedef struct {
+	u8 frame[REC_FRAMESIZE];
+	u8 palette[256 * 3];
+	u32 number;		// emulated frame number
+	u32 repeat;		// frames dropped just before this one
+} recframe;
+
+typedef struct {
+	u32 pos;		// audio ring position the samples were dropped at
+	u32 len;
+} recgap;
+
+struct st_recordstats recordStats;
+
+static lwp_t recthread = LWP_THREAD_NULL;
+static u8 recstack[16384] ATTRIBUTE_ALIGN (8);
+static mutex_t recLock = LWP_MUTEX_NULL;
+static cond_t recCond = LWP_COND_NULL;
+
+static recframe *slots = NULL;
+static s16 *audioring = NULL;
+static u8 *outbuffer = NULL;
+
+// free running counters - head is only written by the emulation thread,
+// tail only by the writer thread
+static volatile u32 slothead = 0;
+static volatile u32 slottail = 0;
+static volatile u32 audiohead = 0;
+static volatile u32 audiotail = 0;
+static recgap gaps[REC_GAPS];
+static volatile u32 gaphead = 0;
+static volatile u32 gaptail = 0;
+static s16 silence[1024];
+static volatile bool recordStop = false;
+
+static bool recording = false;
+static int recformat = RECORD_OFF;
+static int recpolicy = RECORD_DROP;
+static u32 framecount = 0;
+static u32 dropcount = 0;
+static u32 lastdropcount = 0; // drops already attached to a queued frame
+static FILE *videofile = NULL;
+static FILE *wavfile = NULL;
+static u32 wavbytes = 0;
+
+// writer state
+static u8 lastpalette[256 * 3];
+static bool palettevalid = false;
+static u8 yuv[256][3];
+
+static const char *formatnames[RECORD_COUNT] = { "Off", "Y4M + WAV", "Indexed + WAV" };
+
+const char * RecorderFormatName(int format)
+{
+	if(format < 0 || format >= RECORD_COUNT)
+		format = RECORD_OFF;
+	return formatnames[format];
+}
+
+static void PutLE16(u8 *p, u32 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void PutLE32(u8 *p, u32 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/****************************************************************************
+ * WriteWavHeader
+ *
+ * Mono 16-bit PCM at the emulator's output rate. Sizes are patched on stop.
+ ***************************************************************************/
+static void WriteWavHeader(u32 datasize)
+{
+	u8 h[44];
+	u32 rate = FSettings.SndRate;
+
+	memcpy(h, "RIFF", 4);
+	PutLE32(h + 4, datasize + 36);
+	memcpy(h + 8, "WAVEfmt ", 8);
+	PutLE32(h + 16, 16);
+	PutLE16(h + 20, 1);			// PCM
+	PutLE16(h + 22, 1);			// mono
+	PutLE32(h + 24, rate);
+	PutLE32(h + 28, rate * 2);	// bytes per second
+	PutLE16(h + 32, 2);			// block align
+	PutLE16(h + 34, 16);		// bits per sample
+	memcpy(h + 36, "data", 4);
+	PutLE32(h + 40, datasize);
+
+	fseek(wavfile, 0, SEEK_SET);
+	fwrite(h, 1, 44, wavfile);
+}
+
+/****************************************************************************
+ * UpdateYUV
+ *
+ * Palette index -> full range BT.601 YCbCr (Y4M C420jpeg)
+ ***************************************************************************/
+static void UpdateYUV(const u8 *palette)
+{
+	for(int i = 0; i < 256; i++)
+	{
+		int r = palette[i*3], g = palette[i*3+1], b = palette[i*3+2];
+		yuv[i][0] = (19595 * r + 38470 * g + 7471 * b + 32768) >> 16;
+		yuv[i][1] = (-11059 * r - 21709 * g + 32768 * b + (128 << 16) + 32768) >> 16;
+		yuv[i][2] = (32768 * r - 27439 * g - 5329 * b + (128 << 16) + 32768) >> 16;
+	}
+}
+
+static bool WriteY4MFrame(const recframe *f)
+{
+	u8 *ydst = outbuffer;
+	u8 *udst = outbuffer + REC_FRAMESIZE;
+	u8 *vdst = udst + (REC_FRAMESIZE >> 2);
+	const u8 *src = f->frame;
+
+	for(int i = 0; i < REC_FRAMESIZE; i++)
+		ydst[i] = yuv[src[i]][0];
+
+	for(int y = 0; y < REC_HEIGHT; y += 2)
+	{
+		const u8 *l0 = src + y * REC_WIDTH;
+		const u8 *l1 = l0 + REC_WIDTH;
+
+		for(int x = 0; x < REC_WIDTH; x += 2)
+		{
+			*udst++ = (yuv[l0[x]][1] + yuv[l0[x+1]][1] + yuv[l1[x]][1] + yuv[l1[x+1]][1] + 2) >> 2;
+			*vdst++ = (yuv[l0[x]][2] + yuv[l0[x+1]][2] + yuv[l1[x]][2] + yuv[l1[x+1]][2] + 2) >> 2;
+		}
+	}
+
+	// repeat the frame for any that were dropped, to keep audio in sync
+	for(u32 i = 0; i <= f->repeat; i++)
+	{
+		if(fwrite("FRAME\n", 1, 6, videofile) != 6 ||
+			fwrite(outbuffer, 1, REC_Y4MSIZE, videofile) != REC_Y4MSIZE)
+			return false;
+	}
+	return true;
+}
+
+/****************************************************************************
+ * WriteIndexedFrame
+ *
+ * u32 frame number, u8 flags (1 = palette follows), [768 byte palette],
+ * 256x240 palette indices
+ ***************************************************************************/
+static bool WriteIndexedFrame(const recframe *f, bool newpalette)
+{
+	u8 h[5];
+	PutLE32(h, f->number);
+	h[4] = newpalette ? 1 : 0;
+
+	if(fwrite(h, 1, 5, videofile) != 5)
+		return false;
+	if(newpalette && fwrite(f->palette, 1, 768, videofile) != 768)
+		return false;
+	return fwrite(f->frame, 1, REC_FRAMESIZE, videofile) == REC_FRAMESIZE;
+}
+
+static void WriteFrame(const recframe *f)
+{
+	bool newpalette = !palettevalid || memcmp(lastpalette, f->palette, 768) != 0;
+
+	if(newpalette)
+	{
+		memcpy(lastpalette, f->palette, 768);
+		palettevalid = true;
+		if(recformat == RECORD_Y4M)
+			UpdateYUV(f->palette);
+	}
+
+	bool ok;
+
+	if(recformat == RECORD_Y4M)
+		ok = WriteY4MFrame(f);
+	else
+		ok = WriteIndexedFrame(f, newpalette);
+
+	if(ok)
+		recordStats.frames += 1 + (recformat == RECORD_Y4M ? f->repeat : 0);
+}
+
+static void WriteSilence(u32 len)
+{
+	while(len)
+	{
+		u32 n = len < 1024 ? len : 1024;
+		u32 written = fwrite(silence, 2, n, wavfile);
+		wavbytes += written * 2;
+		recordStats.samples += written;
+		len -= n;
+
+		if(written != n)
+			break;
+	}
+}
+
+static void WriteAudio()
+{
+	u32 gap = gaphead; // read before head - a gap is never past the head
+	RING_BARRIER();
+	u32 head = audiohead;
+	u32 tail = audiotail;
+
+	while(1)
+	{
+		u32 end = head;
+
+		if(gaptail != gap)
+		{
+			if(gaps[gaptail % REC_GAPS].pos == tail)
+			{
+				WriteSilence(gaps[gaptail % REC_GAPS].len);
+				gaptail = gaptail + 1;
+				continue;
+			}
+			end = gaps[gaptail % REC_GAPS].pos; // write up to the gap
+		}
+
+		if(tail == end)
+			break;
+
+		u32 pos = tail & (REC_AUDIOSIZE - 1);
+		u32 len = end - tail;
+
+		if(len > REC_AUDIOSIZE - pos)
+			len = REC_AUDIOSIZE - pos; // up to the end of the ring
+
+		u32 written = fwrite(audioring + pos, 2, len, wavfile);
+		wavbytes += written * 2;
+		recordStats.samples += written;
+		tail += len;
+
+		if(written != len)
+			break;
+	}
+	audiotail = tail;
+}
+
+/****************************************************************************
+ * recordcallback
+ *
+ * Writer thread - runs until RecorderStop, draining whatever is queued
+ ***************************************************************************/
+static void *
+recordcallback (void *arg)
+{
+	while(1)
+	{
+		LWP_MutexLock(recLock);
+		while(!recordStop && slothead == slottail && audiohead == audiotail && gaphead == gaptail)
+			LWP_CondWait(recCond, recLock);
+		LWP_MutexUnlock(recLock);
+
+		if(recordStop && slothead == slottail && audiohead == audiotail && gaphead == gaptail)
+			break;
+
+		HoldDeviceThread(); // no device checks while writing
+		WriteAudio();
+
+		if(slothead != slottail)
+		{
+			WriteFrame(&slots[slottail % REC_SLOTS]);
+			RING_BARRIER();
+			slottail = slottail + 1;
+		}
+		ReleaseDeviceThread();
+	}
+	return NULL;
+}
+
+static void WakeWriter()
+{
+	LWP_MutexLock(recLock);
+	LWP_CondSignal(recCond);
+	LWP_MutexUnlock(recLock);
+}
+
+/****************************************************************************
+ * RecorderStart
+ *
+ * basepath is the output path without extension
+ ***************************************************************************/
+bool RecorderStart(const char *basepath, int format, int policy)
+{
+	char path[1024];
+
+	if(recording)
+		RecorderStop();
+
+	if(format != RECORD_Y4M && format != RECORD_INDEXED)
+		return false;
+
+	if(!ChangeInterface((char *)basepath, SILENT))
+		return false;
+
+	slots = (recframe *)memalign(32, sizeof(recframe) * REC_SLOTS);
+	audioring = (s16 *)memalign(32, REC_AUDIOSIZE * sizeof(s16));
+	outbuffer = (u8 *)memalign(32, REC_Y4MSIZE);
+
+	if(!slots || !audioring || !outbuffer)
+		goto fail;
+
+	snprintf(path, 1024, "%s.%s", basepath, format == RECORD_Y4M ? "y4m" : "ifv");
+	videofile = fopen(path, "wb");
+	snprintf(path, 1024, "%s.wav", basepath);
+	wavfile = fopen(path, "wb");
+
+	if(!videofile || !wavfile)
+		goto fail;
+
+	// bigger stdio buffers - frames are written in one call anyway
+	setvbuf(videofile, NULL, _IOFBF, 64*1024);
+	setvbuf(wavfile, NULL, _IOFBF, 16*1024);
+
+	if(format == RECORD_Y4M)
+	{
+		// FCEUI_GetDesiredFPS() is fps in 8.24 fixed point, NES pixels are 8:7
+		fprintf(videofile, "YUV4MPEG2 W%d H%d F%d:%d Ip A8:7 C420jpeg\n",
+			REC_WIDTH, REC_HEIGHT, FCEUI_GetDesiredFPS(), 1 << 24);
+	}
+	else
+	{
+		u8 h[16];
+		memcpy(h, "FCEUIFV1", 8);
+		PutLE16(h + 8, REC_WIDTH);
+		PutLE16(h + 10, REC_HEIGHT);
+		PutLE32(h + 12, FCEUI_GetDesiredFPS());
+		fwrite(h, 1, 16, videofile);
+	}
+
+	wavbytes = 0;
+	WriteWavHeader(0);
+
+	memset(&recordStats, 0, sizeof(recordStats));
+	slothead = slottail = 0;
+	audiohead = audiotail = 0;
+	gaphead = gaptail = 0;
+	framecount = dropcount = lastdropcount = 0;
+	palettevalid = false;
+	recordStop = false;
+	recformat = format;
+	recpolicy = policy;
+
+	if(recLock == LWP_MUTEX_NULL)
+	{
+		LWP_MutexInit(&recLock, false);
+		LWP_CondInit(&recCond);
+	}
+
+	if(LWP_CreateThread (&recthread, recordcallback, NULL, recstack, sizeof(recstack), 40) < 0)
+		goto fail;
+
+	recording = true;
+	return true;
+
+fail:
+	recthread = LWP_THREAD_NULL;
+	if(videofile) fclose(videofile);
+	if(wavfile) fclose(wavfile);
+	videofile = wavfile = NULL;
+	free(slots); slots = NULL;
+	free(audioring); audioring = NULL;
+	free(outbuffer); outbuffer = NULL;
+	return false;
+}
+
+/****************************************************************************
+ * RecorderStartAuto
+ *
+ * Records to the screenshots folder as <rom>-N.y4m/.ifv + <rom>-N.wav
+ ***************************************************************************/
+bool RecorderStartAuto()
+{
+	char basepath[1024];
+	char wavpath[1024];
+	struct stat st;
+
+	if(!ChangeInterface(GCSettings.SaveMethod, SILENT))
+		return false;
+
+	for(int u = 0; u < 99999; u++)
+	{
+		snprintf(basepath, 1000, "%s%s/%s-%d", pathPrefix[GCSettings.SaveMethod], GCSettings.ScreenshotsFolder, romFilename, u);
+		snprintf(wavpath, 1024, "%s.wav", basepath);
+		if(stat(wavpath, &st) != 0)
+			break;
+	}
+	return RecorderStart(basepath, GCSettings.recording, GCSettings.recordpolicy);
+}
+
+/****************************************************************************
+ * RecorderStop
+ *
+ * Waits for the writer to drain both rings, then finalizes the files
+ ***************************************************************************/
+void RecorderStop()
+{
+	if(!recording)
+		return;
+
+	recording = false;
+	recordStop = true;
+	WakeWriter();
+	LWP_JoinThread(recthread, NULL);
+	recthread = LWP_THREAD_NULL;
+
+	WriteWavHeader(wavbytes);
+	fclose(wavfile);
+	fclose(videofile);
+	videofile = wavfile = NULL;
+
+	free(slots); slots = NULL;
+	free(audioring); audioring = NULL;
+	free(outbuffer); outbuffer = NULL;
+}
+
+bool RecorderActive()
+{
+	return recording;
+}
+
+/****************************************************************************
+ * FCEU AVI interface
+ ***************************************************************************/
+int FCEUI_AviBegin(const char* fname)
+{
+	return RecorderStart(fname, GCSettings.recording ? GCSettings.recording : RECORD_Y4M, GCSettings.recordpolicy);
+}
+
+void FCEUI_AviEnd(void)
+{
+	RecorderStop();
+}
+
+bool FCEUI_AviIsRecording()
+{
+	return recording;
+}
+
+void FCEUD_AviRecordTo(void)
+{
+	if(!recording)
+		RecorderStartAuto();
+}
+
+void FCEUD_AviStop(void)
+{
+	RecorderStop();
+}
+
+void FCEUI_AviVideoUpdate(const unsigned char* buffer)
+{
+	if(!recording)
+		return;
+
+	u32 number = framecount++;
+
+	if(slothead - slottail >= REC_SLOTS)
+	{
+		if(recpolicy == RECORD_DROP)
+		{
+			dropcount++;
+			recordStats.dropped = dropcount;
+			return;
+		}
+
+		while(slothead - slottail >= REC_SLOTS)
+		{
+			WakeWriter();
+			usleep(THREAD_SLEEP);
+		}
+	}
+
+	recframe *f = &slots[slothead % REC_SLOTS];
+	memcpy(f->frame, buffer, REC_FRAMESIZE);
+
+	for(int i = 0; i < 256; i++)
+		FCEUD_GetPalette(i, &f->palette[i*3], &f->palette[i*3+1], &f->palette[i*3+2]);
+
+	f->number = number;
+	f->repeat = dropcount - lastdropcount;
+	lastdropcount = dropcount;
+
+	RING_BARRIER();
+	slothead = slothead + 1;
+	WakeWriter();
+}
+
+/****************************************************************************
+ * FCEUI_AviSoundUpdate
+ *
+ * soundData is soundLen mono 16-bit little endian samples (see wave.cpp)
+ ***************************************************************************/
+void FCEUI_AviSoundUpdate(void* soundData, int soundLen)
+{
+	if(!recording || soundLen <= 0)
+		return;
+
+	u32 len = soundLen;
+
+	if(REC_AUDIOSIZE - (audiohead - audiotail) < len)
+	{
+		if(recpolicy == RECORD_DROP && gaphead - gaptail < REC_GAPS)
+		{
+			// the writer puts silence in their place
+			recgap *g = &gaps[gaphead % REC_GAPS];
+			g->pos = audiohead;
+			g->len = len;
+			RING_BARRIER();
+			gaphead = gaphead + 1;
+			recordStats.samplesdropped += len;
+			WakeWriter();
+			return;
+		}
+
+		while(REC_AUDIOSIZE - (audiohead - audiotail) < len)
+		{
+			WakeWriter();
+			usleep(THREAD_SLEEP);
+		}
+	}
+
+	s16 *src = (s16 *)soundData;
+	u32 pos = audiohead & (REC_AUDIOSIZE - 1);
+	u32 first = REC_AUDIOSIZE - pos;
+
+	if(first > len)
+		first = len;
+
+	memcpy(audioring + pos, src, first * sizeof(s16));
+	memcpy(audioring, src + first, (len - first) * sizeof(s16));
+
+	RING_BARRIER();
+	audiohead = audiohead + len;
+	WakeWriter();
+}
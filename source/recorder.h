@@ -0,0 +1,44 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * recorder.h
+ *
+ * Raw video (Y4M / indexed) and WAV capture
+ ****************************************************************************/
+
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+
+#include <gctypes.h>
+
+enum {
+	RECORD_OFF,
+	RECORD_Y4M,		// palette expanded YUV 4:2:0 + WAV
+	RECORD_INDEXED,	// raw palette indices + palette changes + WAV
+	RECORD_COUNT
+};
+
+enum {
+	RECORD_DROP,		// drop frames when the writer falls behind
+	RECORD_THROTTLE		// wait for the writer (slows emulation)
+};
+
+struct st_recordstats {
+	u32 frames;		// frames written
+	u32 dropped;	// frames dropped because the ring was full
+	u32 samples;	// audio samples written
+	u32 samplesdropped;
+};
+
+bool RecorderStart(const char *basepath, int format, int policy);
+bool RecorderStartAuto();
+void RecorderStop();
+bool RecorderActive();
+const char * RecorderFormatName(int format);
+
+extern struct st_recordstats recordStats;
+
+#endif
@@ -0,0 +1,280 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * rewind.cpp
+ *
+ * In-memory rewind history
+ *
+ * Every REWIND_INTERVAL frames an uncompressed savestate is taken. Only the
+ * newest snapshot is kept whole - the history holds the XOR of each snapshot
+ * with the one before it, leaving out the runs of unchanged words. Rewinding
+ * XORs the newest delta back into the kept snapshot, which turns it into the
+ * previous one, and loads it. The history is a ring of REWIND_SIZE bytes, and
+ * the oldest deltas are dropped when it is full.
+ *
+ * Snapshots leave out the back buffer, as the frame emulated after a load
+ * draws it again. Each one is taken over the snapshot from two captures ago,
+ * and the core copies only the pages of RAM, WRAM and CHR RAM that were
+ * written since that one.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "fceusupport.h"
+#include "fileop.h"
+#include "rewind.h"
+
+#define SNAPSHOT_SIZE SAVEBUFFERSIZE
+#define SNAPSHOT_WORDS (SNAPSHOT_SIZE / 4)
+#define DELTA_WORDS (SNAPSHOT_WORDS + (SNAPSHOT_WORDS >> 15) + 4) // worst case
+#define ENTRY_EXTRA 12 // size before the delta, older snapshot length and size after
+#define RUN_MAX 0xFFFF
+
+struct st_rewindstats rewindStats;
+
+static u8 *ring = NULL;
+static u32 *snap[2] = { NULL, NULL };
+static u32 *delta = NULL;
+static u32 snaplen[2] = { 0, 0 }; // bytes past these are zero
+static u32 capture[2] = { 0, 0 }; // core capture each snapshot holds
+static int newest = 0; // snap[] holding the newest snapshot
+static int frames = 0;
+
+// free running byte counters - entries are added and removed at the head,
+// and dropped at the tail
+static u32 ringhead = 0;
+static u32 ringtail = 0;
+static u32 entries = 0;
+
+static void RingWrite(u32 pos, const void *src, u32 len)
+{
+	pos &= REWIND_SIZE - 1;
+	u32 first = REWIND_SIZE - pos;
+
+	if(first > len)
+		first = len;
+
+	memcpy(ring + pos, src, first);
+	memcpy(ring, (const u8 *)src + first, len - first);
+}
+
+static void RingRead(u32 pos, void *dst, u32 len)
+{
+	pos &= REWIND_SIZE - 1;
+	u32 first = REWIND_SIZE - pos;
+
+	if(first > len)
+		first = len;
+
+	memcpy(dst, ring + pos, first);
+	memcpy((u8 *)dst + first, ring, len - first);
+}
+
+static u32 RingWord(u32 pos)
+{
+	u32 word;
+	RingRead(pos, &word, 4);
+	return word;
+}
+
+/****************************************************************************
+ * EncodeDelta
+ *
+ * Writes a ^ b as tokens of (unchanged words << 16 | changed words), each
+ * followed by the changed words. Returns the number of words written.
+ ***************************************************************************/
+static u32 EncodeDelta(const u32 *a, const u32 *b, u32 words, u32 *out)
+{
+	u32 i = 0, n = 0;
+
+	while(i < words)
+	{
+		u32 same = 0, changed = 0;
+		u32 *token = &out[n++];
+
+		while(i < words && same < RUN_MAX && a[i] == b[i])
+		{
+			same++;
+			i++;
+		}
+		while(i < words && changed < RUN_MAX && a[i] != b[i])
+		{
+			out[n++] = a[i] ^ b[i];
+			changed++;
+			i++;
+		}
+		*token = (same << 16) | changed;
+	}
+	return n;
+}
+
+static void ApplyDelta(u32 *dst, const u32 *in, u32 words)
+{
+	const u32 *end = in + words;
+
+	while(in < end)
+	{
+		u32 token = *in++;
+		u32 changed = token & RUN_MAX;
+
+		dst += token >> 16;
+		while(changed--)
+			*dst++ ^= *in++;
+	}
+}
+
+static void DropOldest()
+{
+	ringtail += RingWord(ringtail) + ENTRY_EXTRA;
+	entries--;
+}
+
+void RewindReset()
+{
+	for(int i = 0; i < 2; i++)
+	{
+		if(snap[i])
+			memset(snap[i], 0, snaplen[i]);
+		snaplen[i] = 0;
+		capture[i] = 0;
+	}
+	ringhead = ringtail = 0;
+	entries = 0;
+	frames = 0;
+	memset(&rewindStats, 0, sizeof(rewindStats));
+}
+
+/****************************************************************************
+ * RewindSetup
+ *
+ * Allocates the history when rewind is enabled, and frees it when disabled
+ ***************************************************************************/
+void RewindSetup(bool enable)
+{
+	if(enable && ring)
+		return;
+
+	if(ring) free(ring);
+	if(snap[0]) free(snap[0]);
+	if(snap[1]) free(snap[1]);
+	if(delta) free(delta);
+	ring = NULL;
+	snap[0] = snap[1] = NULL;
+	delta = NULL;
+	RewindReset();
+	FCEUSS_TrackWrites(enable);
+
+	if(!enable)
+		return;
+
+	ring = (u8 *)memalign(32, REWIND_SIZE);
+	snap[0] = (u32 *)memalign(32, SNAPSHOT_SIZE);
+	snap[1] = (u32 *)memalign(32, SNAPSHOT_SIZE);
+	delta = (u32 *)memalign(32, DELTA_WORDS * 4);
+
+	if(!ring || !snap[0] || !snap[1] || !delta)
+	{
+		RewindSetup(false); // not enough memory
+		return;
+	}
+	memset(snap[0], 0, SNAPSHOT_SIZE);
+	memset(snap[1], 0, SNAPSHOT_SIZE);
+}
+
+/****************************************************************************
+ * RewindCapture
+ *
+ * Called after each emulated frame. The work is the small fields and written
+ * pages of one savestate, one pass over it and the copy of the changes, so
+ * it is bounded by the state size.
+ ***************************************************************************/
+void RewindCapture()
+{
+	if(!ring || ++frames < REWIND_INTERVAL)
+		return;
+
+	frames = 0;
+
+	u64 start = gettime();
+	int cur = newest ^ 1;
+	u32 len = FCEUSS_SaveArena((u8 *)snap[cur], SNAPSHOT_SIZE, false, &capture[cur]);
+
+	if(len == 0)
+		return; // too large for a snapshot
+
+	if(len < snaplen[cur])
+		memset((u8 *)snap[cur] + len, 0, snaplen[cur] - len);
+	snaplen[cur] = len;
+
+	if(snaplen[newest])
+	{
+		u32 oldlen = snaplen[newest];
+		u32 words = ((len > oldlen ? len : oldlen) + 3) >> 2;
+		u32 size = EncodeDelta(snap[cur], snap[newest], words, delta) << 2;
+
+		if(size + ENTRY_EXTRA > REWIND_SIZE)
+		{
+			ringhead = ringtail = 0; // start the history over
+			entries = 0;
+		}
+		else
+		{
+			while(REWIND_SIZE - (ringhead - ringtail) < size + ENTRY_EXTRA)
+				DropOldest();
+
+			RingWrite(ringhead, &size, 4);
+			RingWrite(ringhead + 4, delta, size);
+			RingWrite(ringhead + 4 + size, &oldlen, 4);
+			RingWrite(ringhead + 8 + size, &size, 4);
+			ringhead += size + ENTRY_EXTRA;
+			entries++;
+		}
+	}
+	newest = cur;
+
+	rewindStats.snapshots = entries + 1;
+	rewindStats.used = ringhead - ringtail;
+	rewindStats.capture = diff_usec(start, gettime());
+	if(rewindStats.capture > rewindStats.capturemax)
+		rewindStats.capturemax = rewindStats.capture;
+}
+
+/****************************************************************************
+ * RewindStep
+ *
+ * Loads the snapshot before the newest one, and makes it the newest. Once
+ * the history is used up the oldest snapshot is loaded again. Returns false
+ * if there is nothing to load.
+ ***************************************************************************/
+bool RewindStep()
+{
+	if(!ring || !snaplen[newest])
+		return false;
+
+	if(entries)
+	{
+		u32 size = RingWord(ringhead - 4);
+		u32 oldlen = RingWord(ringhead - 8);
+
+		RingRead(ringhead - 8 - size, delta, size);
+		ApplyDelta(snap[newest], delta, size >> 2);
+		snaplen[newest] = oldlen;
+		capture[newest] = 0; // no longer the state of that capture
+		ringhead -= size + ENTRY_EXTRA;
+		entries--;
+	}
+
+	EMUFILE_MEMFILE save(snap[newest], snaplen[newest]);
+	FCEUSS_LoadFP(&save, SSLOADPARAM_NOBACKUP);
+
+	frames = 0;
+	rewindStats.snapshots = entries + 1;
+	rewindStats.used = ringhead - ringtail;
+	return true;
+}
@@ -0,0 +1,38 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * rewind.h
+ *
+ * In-memory rewind history
+ ****************************************************************************/
+
+#ifndef _REWIND_H_
+#define _REWIND_H_
+
+#include <gctypes.h>
+
+#ifdef HW_RVL
+#define REWIND_SIZE (8 * 1024 * 1024)	// history budget in bytes, power of two
+#else
+#define REWIND_SIZE (2 * 1024 * 1024)
+#endif
+#define REWIND_INTERVAL 1	// frames between snapshots
+
+struct st_rewindstats {
+	u32 snapshots;	// snapshots held in the history
+	u32 used;		// bytes of the history in use
+	u32 capture;	// usecs taken by the last capture
+	u32 capturemax;	// slowest capture since the history was reset
+};
+
+void RewindSetup(bool enable);
+void RewindReset();
+void RewindCapture();
+bool RewindStep();
+
+extern struct st_rewindstats rewindStats;
+
+#endif
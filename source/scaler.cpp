@@ -0,0 +1,303 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ * Tanooki 2019-2023
+ *
+ * scaler.cpp
+ *
+ * Pixel art upscaling filters
+ *
+ * Scale2x/Scale3x (AdvMAME) edge rules applied to the emulator's palette
+ * indices, so that edge detection is exact and the filter runs before the
+ * palette lookup. 4x is Scale2x applied twice.
+ *
+ * The frame is processed in horizontal bands of SCALER_BAND_LINES source
+ * lines. Each band is scaled into a small buffer and immediately converted
+ * into 4x4 RGB565 texture tiles while it is still in the data cache. The
+ * Broadway/Gekko CPU has a single core, so the bands run back to back on
+ * the calling thread.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "scaler.h"
+
+#define SRC_WIDTH 256
+#define SRC_HEIGHT 240
+#define MAX_FACTOR 4
+
+static u16 *scaledtex = NULL; // scaled RGB565 texture
+static int scaledfactor = 0;
+
+// one band of scaled palette indices
+static u8 bandbuf[SCALER_BAND_LINES * MAX_FACTOR * SRC_WIDTH * MAX_FACTOR] ATTRIBUTE_ALIGN(32);
+// Scale2x output of the band (plus one neighbouring line each side) for 4x
+static u8 midbuf[(SCALER_BAND_LINES + 2) * 2 * SRC_WIDTH * 2] ATTRIBUTE_ALIGN(32);
+
+static const char *scalernames[SCALER_COUNT] = { "Off", "Scale2x", "Scale3x", "Scale4x" };
+
+int ScalerFactor(int scaler)
+{
+	switch(scaler)
+	{
+		case SCALER_2X: return 2;
+		case SCALER_3X: return 3;
+		case SCALER_4X: return 4;
+	}
+	return 1;
+}
+
+const char * ScalerName(int scaler)
+{
+	if(scaler < 0 || scaler >= SCALER_COUNT)
+		scaler = SCALER_NONE;
+	return scalernames[scaler];
+}
+
+/****************************************************************************
+ * ScalerSetup
+ *
+ * Allocates (and clears) the texture for the given scale factor
+ * Returns NULL when scaling is disabled or memory is unavailable
+ ***************************************************************************/
+u16 * ScalerSetup(int factor)
+{
+	if(factor < 2 || factor > MAX_FACTOR)
+	{
+		ScalerShutdown();
+		return NULL;
+	}
+
+	int size = SRC_WIDTH * factor * SRC_HEIGHT * factor * 2;
+
+	if(factor != scaledfactor)
+	{
+		ScalerShutdown();
+		scaledtex = (u16 *)memalign(32, size);
+		if(!scaledtex)
+			return NULL;
+		scaledfactor = factor;
+	}
+
+	memset(scaledtex, 0, size);
+	DCFlushRange(scaledtex, size);
+	return scaledtex;
+}
+
+void ScalerShutdown()
+{
+	if(scaledtex)
+		free(scaledtex);
+	scaledtex = NULL;
+	scaledfactor = 0;
+}
+
+/****************************************************************************
+ * Scale2xLine / Scale3xLine
+ *
+ * Scale one line of palette indices. above/below are the neighbouring lines
+ * (the line itself at the frame edges).
+ ***************************************************************************/
+static void Scale2xLine(u8 *dst0, u8 *dst1, const u8 *above, const u8 *src, const u8 *below, int width)
+{
+	for(int x = 0; x < width; x++)
+	{
+		u8 B = above[x];
+		u8 D = src[x > 0 ? x - 1 : x];
+		u8 E = src[x];
+		u8 F = src[x < width - 1 ? x + 1 : x];
+		u8 H = below[x];
+
+		if(B != H && D != F)
+		{
+			dst0[0] = D == B ? D : E;
+			dst0[1] = B == F ? F : E;
+			dst1[0] = D == H ? D : E;
+			dst1[1] = H == F ? F : E;
+		}
+		else
+		{
+			dst0[0] = dst0[1] = E;
+			dst1[0] = dst1[1] = E;
+		}
+		dst0 += 2;
+		dst1 += 2;
+	}
+}
+
+static void Scale3xLine(u8 *dst0, u8 *dst1, u8 *dst2, const u8 *above, const u8 *src, const u8 *below, int width)
+{
+	for(int x = 0; x < width; x++)
+	{
+		int l = x > 0 ? x - 1 : x;
+		int r = x < width - 1 ? x + 1 : x;
+
+		u8 A = above[l], B = above[x], C = above[r];
+		u8 D = src[l],   E = src[x],   F = src[r];
+		u8 G = below[l], H = below[x], I = below[r];
+
+		if(B != H && D != F)
+		{
+			dst0[0] = D == B ? D : E;
+			dst0[1] = ((D == B && E != C) || (B == F && E != A)) ? B : E;
+			dst0[2] = B == F ? F : E;
+			dst1[0] = ((D == B && E != G) || (D == H && E != A)) ? D : E;
+			dst1[1] = E;
+			dst1[2] = ((B == F && E != I) || (H == F && E != C)) ? F : E;
+			dst2[0] = D == H ? D : E;
+			dst2[1] = ((D == H && E != I) || (H == F && E != G)) ? H : E;
+			dst2[2] = H == F ? F : E;
+		}
+		else
+		{
+			dst0[0] = dst0[1] = dst0[2] = E;
+			dst1[0] = dst1[1] = dst1[2] = E;
+			dst2[0] = dst2[1] = dst2[2] = E;
+		}
+		dst0 += 3;
+		dst1 += 3;
+		dst2 += 3;
+	}
+}
+
+/****************************************************************************
+ * ScaleBand
+ *
+ * Scales source lines [y0, y1) into bandbuf, pitch = SRC_WIDTH * factor
+ ***************************************************************************/
+static void ScaleBand(const u8 * const *lines, int y0, int y1, int factor)
+{
+	int pitch = SRC_WIDTH * factor;
+	u8 *dst = bandbuf;
+
+	if(factor == 4)
+	{
+		// first pass: Scale2x of source lines [y0-1, y1] into midbuf
+		int m0 = y0 > 0 ? y0 - 1 : y0;
+		int m1 = y1 < SRC_HEIGHT ? y1 + 1 : y1;
+		int midpitch = SRC_WIDTH * 2;
+
+		for(int y = m0; y < m1; y++)
+		{
+			const u8 *line = lines[y];
+			u8 *out = midbuf + (y - m0) * 2 * midpitch;
+			Scale2xLine(out, out + midpitch,
+				y > 0 ? lines[y - 1] : line, line,
+				y < SRC_HEIGHT - 1 ? lines[y + 1] : line, SRC_WIDTH);
+		}
+
+		// second pass: Scale2x of intermediate lines [2*y0, 2*y1)
+		int base = m0 * 2;
+		int last = SRC_HEIGHT * 2 - 1;
+
+		for(int i = y0 * 2; i < y1 * 2; i++)
+		{
+			int ia = i > 0 ? i - 1 : i;
+			int ib = i < last ? i + 1 : i;
+			Scale2xLine(dst, dst + pitch,
+				midbuf + (ia - base) * midpitch,
+				midbuf + (i - base) * midpitch,
+				midbuf + (ib - base) * midpitch, midpitch);
+			dst += pitch * 2;
+		}
+		return;
+	}
+
+	for(int y = y0; y < y1; y++)
+	{
+		const u8 *line = lines[y];
+		const u8 *above = y > 0 ? lines[y - 1] : line;
+		const u8 *below = y < SRC_HEIGHT - 1 ? lines[y + 1] : line;
+
+		if(factor == 3)
+		{
+			Scale3xLine(dst, dst + pitch, dst + pitch * 2, above, line, below, SRC_WIDTH);
+			dst += pitch * 3;
+		}
+		else
+		{
+			Scale2xLine(dst, dst + pitch, above, line, below, SRC_WIDTH);
+			dst += pitch * 2;
+		}
+	}
+}
+
+/****************************************************************************
+ * TileBand
+ *
+ * Converts scaled indices into 4x4 RGB565 texture tiles. Each scaled row
+ * uses the palette of the source line it came from.
+ ***************************************************************************/
+static void TileBand(u16 *texture, const u8 *src, int pitch, int rows, int cols, int tilestride, const u16 * const *palettes, int factor)
+{
+	for(int height = 0; height < rows; height += 4)
+	{
+		u16 *tex = texture;
+		const u8 *src1 = src;
+		const u8 *src2 = src + pitch;
+		const u8 *src3 = src + pitch * 2;
+		const u8 *src4 = src + pitch * 3;
+		const u16 *pal1 = palettes[height / factor];
+		const u16 *pal2 = palettes[(height + 1) / factor];
+		const u16 *pal3 = palettes[(height + 2) / factor];
+		const u16 *pal4 = palettes[(height + 3) / factor];
+
+		for(int width = 0; width < cols; width += 4)
+		{
+			*tex++ = pal1[*src1++];
+			*tex++ = pal1[*src1++];
+			*tex++ = pal1[*src1++];
+			*tex++ = pal1[*src1++];
+
+			*tex++ = pal2[*src2++];
+			*tex++ = pal2[*src2++];
+			*tex++ = pal2[*src2++];
+			*tex++ = pal2[*src2++];
+
+			*tex++ = pal3[*src3++];
+			*tex++ = pal3[*src3++];
+			*tex++ = pal3[*src3++];
+			*tex++ = pal3[*src3++];
+
+			*tex++ = pal4[*src4++];
+			*tex++ = pal4[*src4++];
+			*tex++ = pal4[*src4++];
+			*tex++ = pal4[*src4++];
+		}
+		src += pitch * 4;
+		texture += tilestride;
+	}
+}
+
+/****************************************************************************
+ * ScalerRender
+ *
+ * Scales the 256x240 indexed frame into a (256*factor)x(240*factor) RGB565
+ * texture. lines holds a pointer to each of the 240 source lines, so the
+ * frame does not have to be contiguous (e.g. overlay lines on top of the
+ * emulator output), and palettes the RGB565 palette for each line (e.g. for
+ * its emphasis bits). borderheight/borderwidth are in source pixels and
+ * must be multiples of SCALER_BAND_LINES.
+ ***************************************************************************/
+void ScalerRender(u16 *texture, const u8 * const *lines, const u16 * const *palettes, int factor, int borderheight, int borderwidth)
+{
+	int pitch = SRC_WIDTH * factor;
+	int tilestride = pitch * 4; // texels in one row of tiles
+	int cols = (SRC_WIDTH - (borderwidth << 1)) * factor;
+	const u8 *bandsrc = bandbuf + borderwidth * factor;
+
+	texture += borderheight * factor * pitch + borderwidth * factor * 4;
+
+	for(int y = borderheight; y < SRC_HEIGHT - borderheight; y += SCALER_BAND_LINES)
+	{
+		int rows = SCALER_BAND_LINES * factor;
+		ScaleBand(lines, y, y + SCALER_BAND_LINES, factor);
+		TileBand(texture, bandsrc, pitch, rows, cols, tilestride, palettes + y, factor);
+		texture += rows * pitch;
+	}
+}
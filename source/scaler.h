@@ -0,0 +1,36 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ * Tanooki 2019-2023
+ *
+ * scaler.h
+ *
+ * Pixel art upscaling filters
+ ****************************************************************************/
+
+#ifndef _SCALER_H_
+#define _SCALER_H_
+
+#include <gctypes.h>
+
+enum {
+	SCALER_NONE,
+	SCALER_2X,
+	SCALER_3X,
+	SCALER_4X,
+	SCALER_COUNT
+};
+
+// source lines processed per band - keeps every scaled band a whole number
+// of 4x4 texture tiles and matches the overscan crop granularity
+#define SCALER_BAND_LINES 8
+
+int ScalerFactor(int scaler);
+const char * ScalerName(int scaler);
+u16 * ScalerSetup(int factor);
+void ScalerShutdown();
+void ScalerRender(u16 *texture, const u8 * const *lines, const u16 * const *palettes, int factor, int borderheight, int borderwidth);
+
+#endif
@@ -0,0 +1,273 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * statebench.cpp
+ *
+ * Savestate benchmark over a folder of ROMs
+ *
+ * Each ROM in the folder is loaded and run for STATEBENCH_FRAMES frames
+ * without output. Then the state is taken, compressed with zlib and the
+ * LZ codec, decompressed and loaded again STATEBENCH_RUNS times. The median
+ * time of each step and the state sizes are written to statebench.csv in
+ * the save folder, a row per ROM followed by a row per mapper with the
+ * medians of its ROMs.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <dirent.h>
+#include <zlib.h>
+
+#include "fceuxtx.h"
+#include "fceusupport.h"
+#include "filebrowser.h"
+#include "fileop.h"
+#include "fceuload.h"
+#include "menu.h"
+#include "statebench.h"
+#include "statewriter.h"
+#include "fceux/utils/lz.h"
+
+#define BENCH_MAXROMS 1024
+
+enum {
+	BENCH_CAPTURE,
+	BENCH_ZLIB,
+	BENCH_UNZLIB,
+	BENCH_LZ,
+	BENCH_UNLZ,
+	BENCH_RESTORE,
+	BENCH_STEPS
+};
+
+static const char *stepNames[BENCH_STEPS] = {
+	"capture_us", "zlib_us", "unzlib_us", "lz_us", "unlz_us", "restore_us"
+};
+
+typedef struct {
+	char mapper[8];
+	u32 size[3];	// raw, zlib, lz
+	u32 time[BENCH_STEPS];
+} benchresult;
+
+static int CompareU32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+	return x < y ? -1 : x > y;
+}
+
+static u32 Median(u32 *values, int count)
+{
+	qsort(values, count, sizeof(u32), CompareU32);
+	return values[count / 2];
+}
+
+/****************************************************************************
+ * BenchROM
+ *
+ * Returns false if the ROM could not be loaded, or its state could not be
+ * taken or does not survive the codecs
+ ***************************************************************************/
+static bool BenchROM(const char *filepath, u8 *state, u8 *comp, u8 *out, u8 *lzwork, benchresult *r)
+{
+	u32 samples[BENCH_STEPS][STATEBENCH_RUNS];
+	uint8 *gfx;
+	int32 *sound;
+	int32 ssize;
+
+	size_t filesize = LoadFile((char *)nesrom, (char *)filepath, 0, (1024*1024*4), SILENT);
+
+	if(filesize == 0 || GCMemROM(filesize) <= 0)
+		return false;
+
+	if(GameInfo->type == GIT_NSF)
+		return false;
+
+	if(GameInfo->type == GIT_FDS)
+		sprintf(r->mapper, "fds");
+	else if(memcmp(nesrom, "UNIF", 4) == 0)
+		sprintf(r->mapper, "unif");
+	else
+		sprintf(r->mapper, "%d", GameInfo->mappernum);
+
+	for(int i = 0; i < STATEBENCH_FRAMES; i++)
+		FCEUI_Emulate(&gfx, &sound, &ssize, 1);
+
+	for(int run = 0; run < STATEBENCH_RUNS; run++)
+	{
+		u64 start = gettime();
+		u32 size = FCEUSS_SaveArena(state, SAVEBUFFERSIZE);
+		samples[BENCH_CAPTURE][run] = diff_usec(start, gettime());
+
+		if(size <= 16)
+			return false;
+
+		u32 body = size - 16; // after the FCSX header
+		uLongf zlen = LZ_BOUND(SAVEBUFFERSIZE);
+		start = gettime();
+		compress2(comp, &zlen, state + 16, body, STATE_COMPRESSION);
+		samples[BENCH_ZLIB][run] = diff_usec(start, gettime());
+
+		uLongf outlen = SAVEBUFFERSIZE;
+		start = gettime();
+		int err = uncompress(out, &outlen, comp, zlen);
+		samples[BENCH_UNZLIB][run] = diff_usec(start, gettime());
+
+		if(err != Z_OK || outlen != body || memcmp(out, state + 16, body) != 0)
+			return false;
+
+		start = gettime();
+		u32 lzlen = LZCompress(state + 16, body, comp, lzwork);
+		samples[BENCH_LZ][run] = diff_usec(start, gettime());
+
+		start = gettime();
+		int lzout = LZDecompress(comp, lzlen, out, SAVEBUFFERSIZE);
+		samples[BENCH_UNLZ][run] = diff_usec(start, gettime());
+
+		if(lzout != (int)body || memcmp(out, state + 16, body) != 0)
+			return false;
+
+		EMUFILE_MEMFILE save(state, size);
+		start = gettime();
+		FCEUSS_LoadFP(&save, SSLOADPARAM_NOBACKUP);
+		samples[BENCH_RESTORE][run] = diff_usec(start, gettime());
+
+		r->size[0] = size;
+		r->size[1] = 16 + zlen;
+		r->size[2] = 16 + lzlen;
+	}
+
+	for(int step = 0; step < BENCH_STEPS; step++)
+		r->time[step] = Median(samples[step], STATEBENCH_RUNS);
+
+	return true;
+}
+
+static void WriteRow(FILE *fp, const char *kind, const char *name, const benchresult *r)
+{
+	fprintf(fp, "%s,\"%s\",%s,%u,%u,%u", kind, name, r->mapper, r->size[0], r->size[1], r->size[2]);
+
+	for(int step = 0; step < BENCH_STEPS; step++)
+		fprintf(fp, ",%u", r->time[step]);
+
+	fprintf(fp, "\n");
+}
+
+/****************************************************************************
+ * StateBenchmark
+ *
+ * Benchmarks every ROM in folder. Returns the number of ROMs measured, or
+ * -1 if the folder or the CSV file could not be opened. The loaded game is
+ * closed.
+ ***************************************************************************/
+int StateBenchmark(const char *folder)
+{
+	char filepath[1024];
+	char msg[64];
+	struct dirent *entry;
+	int roms = 0;
+	const char *sep = folder[0] && folder[strlen(folder) - 1] == '/' ? "" : "/";
+
+	if(!ChangeInterface(GCSettings.SaveMethod, NOTSILENT))
+		return -1;
+
+	snprintf(filepath, 1024, "%s%s/statebench.csv", pathPrefix[GCSettings.SaveMethod], GCSettings.SaveFolder);
+	FILE *csv = fopen(filepath, "w");
+
+	if(!csv)
+		return -1;
+
+	u8 *state = (u8 *)memalign(32, SAVEBUFFERSIZE);
+	u8 *comp = (u8 *)memalign(32, LZ_BOUND(SAVEBUFFERSIZE));
+	u8 *out = (u8 *)memalign(32, SAVEBUFFERSIZE);
+	u8 *lzwork = (u8 *)memalign(32, LZ_WORKSIZE);
+	benchresult *results = (benchresult *)malloc(BENCH_MAXROMS * sizeof(benchresult));
+	DIR *dir = opendir(folder);
+
+	if(!state || !comp || !out || !lzwork || !results || !dir)
+	{
+		roms = -1;
+		goto done;
+	}
+
+	fprintf(csv, "kind,name,mapper,raw_bytes,zlib_bytes,lz_bytes");
+	for(int step = 0; step < BENCH_STEPS; step++)
+		fprintf(csv, ",%s", stepNames[step]);
+	fprintf(csv, "\n");
+
+	while((entry = readdir(dir)) && roms < BENCH_MAXROMS)
+	{
+		if(entry->d_type == DT_DIR)
+			continue;
+
+		snprintf(filepath, 1024, "%s%s%s", folder, sep, entry->d_name);
+		StripExt(romFilename, entry->d_name);
+		snprintf(msg, 64, "Benchmarking %s...", romFilename);
+		ShowAction(msg);
+
+		if(!BenchROM(filepath, state, comp, out, lzwork, &results[roms]))
+			continue;
+
+		WriteRow(csv, "rom", entry->d_name, &results[roms]);
+		roms++;
+	}
+
+	// per mapper medians of the ROM medians
+	for(int i = 0; i < roms; i++)
+	{
+		bool seen = false;
+
+		for(int j = 0; j < i; j++)
+			if(strcmp(results[j].mapper, results[i].mapper) == 0)
+				seen = true;
+
+		if(seen)
+			continue;
+
+		benchresult m = results[i];
+		u32 *values = (u32 *)malloc(roms * sizeof(u32));
+		int count;
+
+		if(!values)
+			break;
+
+		for(int field = 0; field < 3 + BENCH_STEPS; field++)
+		{
+			count = 0;
+			for(int j = i; j < roms; j++)
+				if(strcmp(results[j].mapper, results[i].mapper) == 0)
+					values[count++] = field < 3 ? results[j].size[field] : results[j].time[field - 3];
+
+			if(field < 3)
+				m.size[field] = Median(values, count);
+			else
+				m.time[field - 3] = Median(values, count);
+		}
+		free(values);
+
+		char name[16];
+		snprintf(name, 16, "%d roms", count);
+		WriteRow(csv, "mapper", name, &m);
+	}
+
+done:
+	if(dir) closedir(dir);
+	fclose(csv);
+	free(state);
+	free(comp);
+	free(out);
+	free(lzwork);
+	free(results);
+	CancelAction();
+	CloseGame();
+	romLoaded = false;
+	romFilename[0] = 0;
+	return roms;
+}
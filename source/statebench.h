@@ -0,0 +1,20 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * statebench.h
+ *
+ * Savestate benchmark over a folder of ROMs
+ ****************************************************************************/
+
+#ifndef _STATEBENCH_H_
+#define _STATEBENCH_H_
+
+#define STATEBENCH_FRAMES 600	// frames run after power on, before measuring
+#define STATEBENCH_RUNS 31		// timed repetitions per ROM
+
+int StateBenchmark(const char *folder);
+
+#endif
@@ -0,0 +1,340 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * statestore.cpp
+ *
+ * Deduplicated savestate storage
+ *
+ * A stored state is split into STORE_BLOCK sized blocks, each compressed
+ * into its own file in the game's store folder, named by a hash of the
+ * block. The slot's .fcs file becomes a manifest listing the hashes, so
+ * blocks that are the same in several slots - or unchanged since the slot
+ * was last saved - are kept and written once. Blocks no manifest of the
+ * game refers to any more are removed by StoreCompact.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "fceuxtx.h"
+#include "fileop.h"
+#include "statestore.h"
+
+#define STORE_MAGIC "FCSM"
+#define STORE_VERSION 1
+#define STORE_HEADER 16 // magic, version, state size, block size
+#define STORE_MAXBLOCKS ((SAVEBUFFERSIZE + STORE_BLOCK - 1) / STORE_BLOCK)
+#define STORE_COMPBLOCK (STORE_BLOCK + (STORE_BLOCK >> 9) + 64) // worst case compression
+
+// one set of buffers for each thread that uses the store - the state writer
+// writes blocks (and checks the ones it reuses), the menu reads them
+static u8 writebuffer[STORE_COMPBLOCK];
+static u8 checkbuffer[STORE_BLOCK];
+static u8 readbuffer[STORE_COMPBLOCK];
+
+static u32 GetLE32(const u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+static void PutLE32(u8 *p, u32 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static u64 HashBlock(const u8 *data, u32 len)
+{
+	return ((u64)crc32(0, data, len) << 32) | adler32(1, data, len);
+}
+
+static void BlockPath(char *path, const char *storedir, u64 hash)
+{
+	snprintf(path, MAXPATHLEN, "%s/%08x%08x", storedir, (u32)(hash >> 32), (u32)hash);
+}
+
+/****************************************************************************
+ * ReadBlock
+ *
+ * Decompresses a stored block into data, using buffer for the compressed
+ * file. Returns false if the block is missing, or is not len bytes with
+ * the given hash - as after a write cut short.
+ ***************************************************************************/
+static bool ReadBlock(const char *path, u64 hash, u8 *data, u32 len, u8 *buffer)
+{
+	FILE *fp = fopen(path, "rb");
+
+	if(!fp)
+		return false;
+
+	u32 complen = fread(buffer, 1, STORE_COMPBLOCK, fp);
+	fclose(fp);
+
+	uLongf blocklen = len;
+
+	return uncompress(data, &blocklen, buffer, complen) == Z_OK &&
+		blocklen == len && HashBlock(data, len) == hash;
+}
+
+/****************************************************************************
+ * GetStoreFolder
+ *
+ * The store folder of a game sits next to its state files
+ ***************************************************************************/
+void GetStoreFolder(char *dir, const char *filepath, const char *game)
+{
+	char folder[MAXPATHLEN];
+	snprintf(folder, MAXPATHLEN, "%s", filepath);
+
+	char *slash = strrchr(folder, '/');
+	if(slash)
+		*slash = 0;
+
+	snprintf(dir, MAXPATHLEN, "%s/%s.store", folder, game);
+}
+
+bool IsStoreManifest(const u8 *data, u32 len)
+{
+	return len >= STORE_HEADER && memcmp(data, STORE_MAGIC, 4) == 0;
+}
+
+/****************************************************************************
+ * StoreWrite
+ *
+ * Writes the blocks of state that are not in the store yet, at the given
+ * zlib level, then the manifest to filepath
+ ***************************************************************************/
+bool StoreWrite(const u8 *state, u32 size, int level, const char *filepath, const char *storedir)
+{
+	u8 manifest[STORE_HEADER + STORE_MAXBLOCKS * 8];
+	char path[MAXPATHLEN];
+	struct stat st;
+	u32 blocks = (size + STORE_BLOCK - 1) / STORE_BLOCK;
+
+	if(blocks > STORE_MAXBLOCKS || !CreateDirectory((char *)storedir))
+		return false;
+
+	memcpy(manifest, STORE_MAGIC, 4);
+	PutLE32(manifest + 4, STORE_VERSION);
+	PutLE32(manifest + 8, size);
+	PutLE32(manifest + 12, STORE_BLOCK);
+
+	for(u32 i = 0; i < blocks; i++)
+	{
+		const u8 *block = state + i * STORE_BLOCK;
+		u32 len = size - i * STORE_BLOCK;
+
+		if(len > STORE_BLOCK)
+			len = STORE_BLOCK;
+
+		u64 hash = HashBlock(block, len);
+		PutLE32(manifest + STORE_HEADER + i * 8, hash >> 32);
+		PutLE32(manifest + STORE_HEADER + i * 8 + 4, hash);
+
+		BlockPath(path, storedir, hash);
+
+		if(stat(path, &st) == 0 && ReadBlock(path, hash, checkbuffer, len, writebuffer))
+			continue; // already stored, and whole
+
+		uLongf complen = STORE_COMPBLOCK;
+
+		if(compress2(writebuffer, &complen, block, len, level) != Z_OK)
+			return false;
+
+		FILE *fp = fopen(path, "wb");
+
+		if(!fp)
+			return false;
+
+		u32 written = fwrite(writebuffer, 1, complen, fp);
+		fclose(fp);
+
+		if(written != complen)
+		{
+			remove(path); // don't leave a partial block to be shared
+			return false;
+		}
+	}
+
+	// not the shared fileop handle - we may run alongside a SaveFile
+	FILE *fp = fopen(filepath, "wb");
+
+	if(!fp)
+		return false;
+
+	u32 len = STORE_HEADER + blocks * 8;
+	u32 written = fwrite(manifest, 1, len, fp);
+	fclose(fp);
+	return written == len;
+}
+
+/****************************************************************************
+ * StoreRead
+ *
+ * Puts the state listed by manifest back together. Returns its size, or 0
+ * if the manifest is invalid, a block is missing or the state does not fit
+ * in maxsize bytes.
+ ***************************************************************************/
+u32 StoreRead(const u8 *manifest, u32 len, const char *storedir, u8 *state, u32 maxsize)
+{
+	char path[MAXPATHLEN];
+
+	if(!IsStoreManifest(manifest, len) || GetLE32(manifest + 4) != STORE_VERSION ||
+		GetLE32(manifest + 12) != STORE_BLOCK)
+		return 0;
+
+	u32 size = GetLE32(manifest + 8);
+	u32 blocks = (size + STORE_BLOCK - 1) / STORE_BLOCK;
+
+	if(size > maxsize || len < STORE_HEADER + blocks * 8)
+		return 0;
+
+	for(u32 i = 0; i < blocks; i++)
+	{
+		u64 hash = ((u64)GetLE32(manifest + STORE_HEADER + i * 8) << 32) |
+			GetLE32(manifest + STORE_HEADER + i * 8 + 4);
+		u32 blocklen = size - i * STORE_BLOCK;
+
+		if(blocklen > STORE_BLOCK)
+			blocklen = STORE_BLOCK;
+
+		BlockPath(path, storedir, hash);
+
+		if(!ReadBlock(path, hash, state + i * STORE_BLOCK, blocklen, readbuffer))
+			return 0;
+	}
+	return size;
+}
+
+static int CompareHash(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+	return x < y ? -1 : x > y;
+}
+
+/****************************************************************************
+ * StoreCompact
+ *
+ * Removes the blocks of the store that none of the game's manifests refer
+ * to. Returns the number of blocks removed, or -1 on error.
+ ***************************************************************************/
+int StoreCompact(const char *storedir)
+{
+	char folder[MAXPATHLEN];
+	char path[MAXPATHLEN];
+	u8 manifest[STORE_HEADER + STORE_MAXBLOCKS * 8];
+	u64 *hashes = NULL;
+	u32 count = 0;
+	int removed = 0;
+	struct dirent *entry;
+
+	// storedir is <folder>/<game>.store
+	snprintf(folder, MAXPATHLEN, "%s", storedir);
+	char *game = strrchr(folder, '/');
+	if(!game || strlen(game) < 7)
+		return -1;
+	*game++ = 0;
+	game[strlen(game) - 6] = 0;
+	int gamelen = strlen(game);
+
+	// collect the blocks every manifest of the game refers to
+	DIR *dir = opendir(folder);
+
+	if(!dir)
+		return -1;
+
+	while((entry = readdir(dir)))
+	{
+		int namelen = strlen(entry->d_name);
+
+		if(namelen < gamelen + 4 || strncmp(entry->d_name, game, gamelen) != 0 ||
+			strcmp(entry->d_name + namelen - 4, ".fcs") != 0)
+			continue;
+
+		snprintf(path, MAXPATHLEN, "%s/%s", folder, entry->d_name);
+		FILE *fp = fopen(path, "rb");
+
+		if(!fp)
+		{
+			closedir(dir);
+			free(hashes);
+			return -1; // it may refer to any of the blocks
+		}
+
+		u32 len = fread(manifest, 1, sizeof(manifest), fp);
+		fclose(fp);
+
+		if(!IsStoreManifest(manifest, len))
+			continue;
+
+		u32 blocks = (len - STORE_HEADER) / 8;
+		u64 *grown = (u64 *)realloc(hashes, (count + blocks) * sizeof(u64));
+
+		if(!grown)
+		{
+			closedir(dir);
+			free(hashes);
+			return -1; // removing blocks without knowing all references is unsafe
+		}
+		hashes = grown;
+
+		for(u32 i = 0; i < blocks; i++)
+			hashes[count++] = ((u64)GetLE32(manifest + STORE_HEADER + i * 8) << 32) |
+				GetLE32(manifest + STORE_HEADER + i * 8 + 4);
+	}
+	closedir(dir);
+
+	qsort(hashes, count, sizeof(u64), CompareHash);
+
+	// find the rest, and remove them once the folder is closed
+	u64 *orphans = NULL;
+	u32 orphancount = 0;
+	dir = opendir(storedir);
+
+	if(!dir)
+	{
+		free(hashes);
+		return 0;
+	}
+
+	while((entry = readdir(dir)))
+	{
+		char *end;
+		u64 hash = strtoull(entry->d_name, &end, 16);
+
+		if(strlen(entry->d_name) != 16 || *end != 0)
+			continue;
+
+		if(count && bsearch(&hash, hashes, count, sizeof(u64), CompareHash))
+			continue;
+
+		u64 *grown = (u64 *)realloc(orphans, (orphancount + 1) * sizeof(u64));
+
+		if(!grown)
+			break;
+
+		orphans = grown;
+		orphans[orphancount++] = hash;
+	}
+	closedir(dir);
+	free(hashes);
+
+	for(u32 i = 0; i < orphancount; i++)
+	{
+		BlockPath(path, storedir, orphans[i]);
+		if(remove(path) == 0)
+			removed++;
+	}
+	free(orphans);
+	return removed;
+}
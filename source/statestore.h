@@ -0,0 +1,25 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * statestore.h
+ *
+ * Deduplicated savestate storage
+ ****************************************************************************/
+
+#ifndef _STATESTORE_H_
+#define _STATESTORE_H_
+
+#include <gctypes.h>
+
+#define STORE_BLOCK 4096	// bytes of state per stored block
+
+void GetStoreFolder(char *dir, const char *filepath, const char *game);
+bool IsStoreManifest(const u8 *data, u32 len);
+bool StoreWrite(const u8 *state, u32 size, int level, const char *filepath, const char *storedir);
+u32 StoreRead(const u8 *manifest, u32 len, const char *storedir, u8 *state, u32 maxsize);
+int StoreCompact(const char *storedir);
+
+#endif
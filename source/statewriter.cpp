@@ -0,0 +1,252 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * statewriter.cpp
+ *
+ * Background compression and writing of savestates
+ *
+ * Queueing takes an uncompressed savestate on the caller's thread, straight
+ * into the pending job. A low priority thread compresses it at the job's
+ * level (zlib, or the core's LZ codec) and writes it out - or into the
+ * game's deduplicated store, when the job has a store folder. A save queued
+ * for the same file while the last one is still pending replaces it; a save
+ * of another file waits for the pending job to be picked up.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "fceuxtx.h"
+#include "fceusupport.h"
+#include "fileop.h"
+#include "statewriter.h"
+#include "statestore.h"
+#include "fceux/utils/lz.h"
+
+#define THREAD_SLEEP 100
+
+#define STATE_HEADER 16 // FCSX header written by FCEUSS_SaveMS
+// worst case compression - zlib says "0.1% larger than sourceLen plus 12
+// bytes", which LZ_BOUND is above
+#define STATE_COMPSIZE (STATE_HEADER + LZ_BOUND(SAVEBUFFERSIZE))
+
+typedef struct {
+	u8 *data;	// uncompressed savestate, header included
+	u32 size;
+	char filepath[1024];
+	char storedir[1024];	// empty to write a state file
+	int level;
+	statewritecallback callback;
+} statejob;
+
+static lwp_t statethread = LWP_THREAD_NULL;
+static u8 statestack[16384] ATTRIBUTE_ALIGN (8);
+static mutex_t stateLock = LWP_MUTEX_NULL;
+static cond_t stateCond = LWP_COND_NULL;
+
+static statejob pending;
+static statejob active;
+static volatile bool jobPending = false;
+static volatile bool jobActive = false;
+
+static u8 *compbuffer = NULL;
+static u8 *lzwork = NULL;
+
+static u32 GetLE32(const u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+static void PutLE32(u8 *p, u32 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/****************************************************************************
+ * CompressState
+ *
+ * Compresses the job's savestate into compbuffer, returns its size (0 if it
+ * is to be written uncompressed)
+ ***************************************************************************/
+static u32 CompressState(const statejob *job)
+{
+	u32 totalsize = GetLE32(job->data + 4);
+
+	if(job->level == Z_NO_COMPRESSION || totalsize > job->size - STATE_HEADER)
+		return 0;
+
+	uLongf comprlen = STATE_COMPSIZE - STATE_HEADER;
+
+	memcpy(compbuffer, job->data, STATE_HEADER);
+
+	if(job->level == FCEU_LZ_COMPRESSION)
+	{
+		comprlen = LZCompress(job->data + STATE_HEADER, totalsize, compbuffer + STATE_HEADER, lzwork);
+		PutLE32(compbuffer + 8, GetLE32(job->data + 8) | FCEUSTATE_HEADER_LZ);
+	}
+	else if(compress2(compbuffer + STATE_HEADER, &comprlen, job->data + STATE_HEADER, totalsize, job->level) != Z_OK)
+	{
+		return 0;
+	}
+
+	PutLE32(compbuffer + 12, comprlen);
+	return STATE_HEADER + comprlen;
+}
+
+/****************************************************************************
+ * WriteState
+ ***************************************************************************/
+static bool WriteState(statejob *job)
+{
+	if(job->storedir[0])
+	{
+		// blocks are always zlib compressed
+		int level = job->level == FCEU_LZ_COMPRESSION ? Z_BEST_SPEED : job->level;
+
+		if(!StoreWrite(job->data, job->size, level, job->filepath, job->storedir))
+			return false;
+
+		StoreCompact(job->storedir); // blocks only the old manifest used
+		return true;
+	}
+
+	u8 *data = compbuffer;
+	u32 size = CompressState(job);
+
+	if(size == 0)
+	{
+		data = job->data;
+		size = job->size;
+	}
+
+	// not the shared fileop handle - we may run alongside a SaveFile
+	FILE *fp = fopen(job->filepath, "wb");
+
+	if(!fp)
+		return false;
+
+	u32 written = fwrite(data, 1, size, fp);
+	fclose(fp);
+	return written == size;
+}
+
+/****************************************************************************
+ * statecallback
+ *
+ * Writer thread - sleeps until a job is queued
+ ***************************************************************************/
+static void *
+statecallback (void *arg)
+{
+	while(1)
+	{
+		LWP_MutexLock(stateLock);
+		while(!jobPending)
+			LWP_CondWait(stateCond, stateLock);
+
+		// swap buffers, so the next save can be taken while this one is written
+		u8 *data = active.data;
+		memcpy(&active, &pending, sizeof(statejob));
+		pending.data = data;
+		jobActive = true;
+		jobPending = false;
+		LWP_MutexUnlock(stateLock);
+
+		HoldDeviceThread(); // no device checks while writing
+		bool success = WriteState(&active);
+		ReleaseDeviceThread();
+
+		if(active.callback)
+			active.callback(active.filepath, success);
+
+		jobActive = false;
+	}
+	return NULL;
+}
+
+void InitStateWriter()
+{
+	pending.data = (u8 *)memalign(32, SAVEBUFFERSIZE);
+	active.data = (u8 *)memalign(32, SAVEBUFFERSIZE);
+	compbuffer = (u8 *)memalign(32, STATE_COMPSIZE);
+	lzwork = (u8 *)memalign(32, LZ_WORKSIZE);
+
+	if(!pending.data || !active.data || !compbuffer || !lzwork)
+		return;
+
+	LWP_MutexInit(&stateLock, false);
+	LWP_CondInit(&stateCond);
+	LWP_CreateThread (&statethread, statecallback, NULL, statestack, sizeof(statestack), 40);
+}
+
+/****************************************************************************
+ * QueueStateWrite
+ *
+ * Saves the current state uncompressed and returns without writing it. The
+ * device holding filepath is mounted here, on the caller's thread. level is
+ * a zlib level or FCEU_LZ_COMPRESSION, Z_NO_COMPRESSION to write the state
+ * as taken. With a storedir the state goes into that store, and filepath
+ * gets its manifest.
+ ***************************************************************************/
+bool QueueStateWrite(const char *filepath, const char *storedir, int level, statewritecallback callback)
+{
+	int device;
+
+	if(statethread == LWP_THREAD_NULL)
+		return false;
+
+	if(!FindDevice((char *)filepath, &device) || !ChangeInterface(device, SILENT))
+		return false;
+
+	// wait for a pending save of another file to be picked up
+	while(jobPending && strcmp(pending.filepath, filepath) != 0)
+		usleep(THREAD_SLEEP);
+
+	LWP_MutexLock(stateLock);
+	u32 size = FCEUSS_SaveArena(pending.data, SAVEBUFFERSIZE);
+	bool success = size > STATE_HEADER;
+
+	if(success)
+	{
+		pending.size = size;
+		snprintf(pending.filepath, 1024, "%s", filepath);
+		snprintf(pending.storedir, 1024, "%s", storedir ? storedir : "");
+		pending.level = level;
+		pending.callback = callback;
+		jobPending = true;
+		LWP_CondSignal(stateCond);
+	}
+	else
+	{
+		jobPending = false; // a replaced save is lost with this one
+		success = false;
+	}
+	LWP_MutexUnlock(stateLock);
+	return success;
+}
+
+bool StateWriterBusy()
+{
+	return jobPending || jobActive;
+}
+
+/****************************************************************************
+ * WaitStateWriter
+ *
+ * Blocks until all queued savestates have been written
+ ***************************************************************************/
+void WaitStateWriter()
+{
+	while(StateWriterBusy())
+		usleep(THREAD_SLEEP);
+}
@@ -0,0 +1,28 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * statewriter.h
+ *
+ * Background compression and writing of savestates
+ ****************************************************************************/
+
+#ifndef _STATEWRITER_H_
+#define _STATEWRITER_H_
+
+#include <gctypes.h>
+
+#define STATE_COMPRESSION 9	// zlib level savestates are written at
+
+// called from the writer thread once the file has been written (or failed) -
+// it should only store the result, for the caller's thread to report
+typedef void (*statewritecallback)(const char *filepath, bool success);
+
+void InitStateWriter();
+bool QueueStateWrite(const char *filepath, const char *storedir, int level, statewritecallback callback);
+bool StateWriterBusy();
+void WaitStateWriter();
+
+#endif
@@ -0,0 +1,229 @@
+/****************************************************************************
+ * FCE Ultra
+ * Nintendo Wii/GameCube Port
+ *
+ * Tantric 2008-2022
+ *
+ * wavelog.cpp
+ *
+ * Background writer for the core's sound log (fceux/wave.cpp)
+ *
+ * The emulation thread only copies each frame's samples into a ring. A
+ * writer thread empties it in WAVELOG_CHUNK sized writes, which start at
+ * chunk-aligned offsets of both the ring and the file. When the log is
+ * closed the rest of the ring is written, and the final header is written
+ * over the start of the file.
+ ****************************************************************************/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "fceuxtx.h"
+#include "fceusupport.h"
+#include "fileop.h"
+
+#define THREAD_SLEEP 100
+
+#define WAVELOG_SIZE (1 << 18)	// bytes, must be a power of two
+#define WAVELOG_CHUNK (1 << 15)	// bytes per write, divides WAVELOG_SIZE
+
+// keep the compiler from moving ring data stores past the index update
+#define RING_BARRIER() __asm__ __volatile__ ("sync" ::: "memory")
+
+static lwp_t logthread = LWP_THREAD_NULL;
+static u8 logstack[16384] ATTRIBUTE_ALIGN (8);
+static mutex_t logLock = LWP_MUTEX_NULL;
+static cond_t logCond = LWP_COND_NULL;
+
+static FILE *logfile = NULL;
+static u8 *logring = NULL;
+
+// free running byte counters - head is only written by the emulation
+// thread, tail only by the writer thread
+static volatile u32 loghead = 0;
+static volatile u32 logtail = 0;
+static volatile bool logStop = false;
+static volatile bool logFailed = false;	// a write failed, nothing more is written
+static volatile u32 logwritten = 0;	// bytes that reached the file
+
+/****************************************************************************
+ * logcallback
+ *
+ * Writer thread - writes whole chunks while logging, and everything that
+ * is left once FCEUD_WaveLogClose asks it to stop
+ ***************************************************************************/
+static void *
+logcallback (void *arg)
+{
+	while(1)
+	{
+		LWP_MutexLock(logLock);
+		while(!logStop && loghead - logtail < WAVELOG_CHUNK)
+			LWP_CondWait(logCond, logLock);
+		LWP_MutexUnlock(logLock);
+
+		u32 tail = logtail;
+		u32 len = loghead - tail;
+		u32 pos = tail & (WAVELOG_SIZE - 1);
+
+		if(len == 0)
+			break; // stopped and drained
+
+		if(logFailed)
+		{
+			logtail = tail + len; // discard what was queued after the error
+			continue;
+		}
+
+		if(len > WAVELOG_CHUNK - (pos & (WAVELOG_CHUNK - 1)))
+			len = WAVELOG_CHUNK - (pos & (WAVELOG_CHUNK - 1)); // up to the next chunk
+
+		HoldDeviceThread(); // no device checks while writing
+		bool ok = fwrite(logring + pos, 1, len, logfile) == len;
+		ReleaseDeviceThread();
+
+		if(ok)
+			logwritten += len;
+		else
+			logFailed = true; // device error - the rest is discarded
+
+		logtail = tail + len;
+	}
+	return NULL;
+}
+
+static void WakeWriter()
+{
+	LWP_MutexLock(logLock);
+	LWP_CondSignal(logCond);
+	LWP_MutexUnlock(logLock);
+}
+
+bool FCEUD_WaveLogOpen(const char *fn)
+{
+	if(logfile)
+		return false;
+
+	if(!ChangeInterface((char *)fn, SILENT))
+		return false;
+
+	logring = (u8 *)memalign(32, WAVELOG_SIZE);
+
+	if(!logring)
+		return false;
+
+	logfile = fopen(fn, "wb");
+
+	if(!logfile)
+		goto fail;
+
+	setvbuf(logfile, NULL, _IONBF, 0); // writes are already chunk sized
+
+	loghead = logtail = 0;
+	logStop = false;
+	logFailed = false;
+	logwritten = 0;
+
+	if(logLock == LWP_MUTEX_NULL)
+	{
+		LWP_MutexInit(&logLock, false);
+		LWP_CondInit(&logCond);
+	}
+
+	if(LWP_CreateThread (&logthread, logcallback, NULL, logstack, sizeof(logstack), 40) < 0)
+		goto fail;
+
+	return true;
+
+fail:
+	logthread = LWP_THREAD_NULL;
+	if(logfile) fclose(logfile);
+	logfile = NULL;
+	free(logring); logring = NULL;
+	return false;
+}
+
+/****************************************************************************
+ * FCEUD_WaveLogWrite
+ *
+ * Queues size bytes. Waits for the writer only if the ring is full.
+ * Returns -1 once a write has failed.
+ ***************************************************************************/
+int FCEUD_WaveLogWrite(const void *data, int size)
+{
+	if(!logfile || size <= 0)
+		return 0;
+
+	if(logFailed)
+		return -1;
+
+	const u8 *src = (const u8 *)data;
+	u32 len = size;
+	u32 head = loghead;
+
+	while(WAVELOG_SIZE - (head - logtail) < len)
+	{
+		if(logFailed)
+			return -1;
+		WakeWriter();
+		usleep(THREAD_SLEEP);
+	}
+
+	u32 pos = head & (WAVELOG_SIZE - 1);
+	u32 first = WAVELOG_SIZE - pos;
+
+	if(first > len)
+		first = len;
+
+	memcpy(logring + pos, src, first);
+	memcpy(logring, src + first, len - first);
+
+	RING_BARRIER();
+	loghead = head + len;
+
+	// wake the writer once per chunk
+	if(((head + len) ^ head) & ~(WAVELOG_CHUNK - 1))
+		WakeWriter();
+
+	return size;
+}
+
+/****************************************************************************
+ * FCEUD_WaveLogFlush
+ *
+ * Writes everything queued and stops the writer. Returns the bytes that
+ * reached the file, which is less than was queued if a write failed.
+ ***************************************************************************/
+int FCEUD_WaveLogFlush()
+{
+	if(!logfile)
+		return 0;
+
+	if(logthread != LWP_THREAD_NULL)
+	{
+		logStop = true;
+		WakeWriter();
+		LWP_JoinThread(logthread, NULL);
+		logthread = LWP_THREAD_NULL;
+	}
+	return logwritten;
+}
+
+void FCEUD_WaveLogClose(const void *header, int size)
+{
+	if(!logfile)
+		return;
+
+	FCEUD_WaveLogFlush();
+
+	fseek(logfile, 0, SEEK_SET);
+	fwrite(header, 1, size, logfile);
+	fclose(logfile);
+	logfile = NULL;
+
+	free(logring);
+	logring = NULL;
+}